@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include "font.h"
+#include "oled.h"
+
+#include "canvas.h"
+
+#define CANVAS_WIDTH    OLED_WIDTH
+#define CANVAS_HEIGHT   OLED_HEIGHT
+
+static void place(uint64_t *col, uint64_t bits, uint64_t mask, int y)
+{
+    // opaque placement of a column fragment at pixel row y
+
+    *col = (*col & ~(mask << y)) | (bits << y);
+}
+
+void canvas_clear(struct canvas *cv)
+{
+    memset(cv->col, 0, sizeof(cv->col));
+}
+
+void canvas_draw_pixel(struct canvas *cv, int x, int y)
+{
+    // set pixel (x, y), 0 <= x < CANVAS_WIDTH, 0 <= y < CANVAS_HEIGHT
+
+    if (x < 0 || x >= CANVAS_WIDTH || y < 0 || y >= CANVAS_HEIGHT)
+        return;
+
+    cv->col[x] |= 1ULL << y;
+}
+
+void canvas_draw_bitmap_xy(struct canvas *cv, int x, int y, int width, int height, const unsigned char *bitmap)
+{
+    // draws a monochrome bitmap at any pixel position (x, y)
+    //
+    // bitmap uses the SSD1306 native layout of oled_draw_bitmap_xy():
+    // ceil(height / 8) bytes per column, LSB on top; height <= 64
+
+    int rows = (height + 7) >> 3;
+    uint64_t mask;
+
+    if (!bitmap || width <= 0 || height <= 0 || height > CANVAS_HEIGHT
+        || x < 0 || y < 0 || x + width > CANVAS_WIDTH || y + height > CANVAS_HEIGHT)
+        return;
+
+    mask = (height == 64) ? ~0ULL : (1ULL << height) - 1;
+
+    for (int c = 0; c < width; c++) {
+        uint64_t bits = 0;
+
+        for (int r = 0; r < rows; r++)
+            bits |= (uint64_t)bitmap[c * rows + r] << (r << 3);
+
+        place(&cv->col[x + c], bits & mask, mask, y);
+    }
+}
+
+void canvas_draw_text_xy(struct canvas *cv, int x, int y, const char *str)
+{
+    // draws a string at any pixel (x, y), each char is 8x16 (cols x rows)
+
+    if (x < 0 || x >= CANVAS_WIDTH || y < 0 || y > CANVAS_HEIGHT - 16)
+        return;
+
+    for (; *str && x <= CANVAS_WIDTH - 8; str++, x += 8) {
+        const unsigned char *glyph;
+
+        if (*str < 32 || *str > 126)
+            continue;
+
+        glyph = ascii_font_2x8[*str - 32];
+        for (int c = 0; c < 8; c++)
+            place(&cv->col[x + c], glyph[2 * c] | (glyph[2 * c + 1] << 8), 0xFFFF, y);
+    }
+}
+
+static void transpose8(uint64_t *r)
+{
+    // 8x8 byte matrix transpose in three rounds of masked swaps,
+    // afterwards byte k of r[j] is byte j of the former r[k]
+
+    const uint64_t m16 = 0x0000FFFF0000FFFFULL;
+    const uint64_t m8 = 0x00FF00FF00FF00FFULL;
+    uint64_t a, b;
+
+    for (int i = 0; i < 4; i++) {
+        a = r[i];
+        b = r[i + 4];
+        r[i] = (a & 0xFFFFFFFFULL) | (b << 32);
+        r[i + 4] = (a >> 32) | (b & 0xFFFFFFFF00000000ULL);
+    }
+
+    for (int i = 0; i < 8; i += 4)
+        for (int j = i; j < i + 2; j++) {
+            a = r[j];
+            b = r[j + 2];
+            r[j] = (a & m16) | ((b & m16) << 16);
+            r[j + 2] = ((a >> 16) & m16) | (b & ~m16);
+        }
+
+    for (int i = 0; i < 8; i += 2) {
+        a = r[i];
+        b = r[i + 1];
+        r[i] = (a & m8) | ((b & m8) << 8);
+        r[i + 1] = ((a >> 8) & m8) | (b & ~m8);
+    }
+}
+
+void canvas_to_pages(const struct canvas *cv, unsigned char *pages)
+{
+    // page p of column x is byte p of col[x]; 8 columns at a time are
+    // transposed in registers so every page gets one 8-byte store
+
+    for (int x = 0; x < CANVAS_WIDTH; x += 8) {
+        uint64_t r[8];
+
+        memcpy(r, &cv->col[x], sizeof(r));
+        transpose8(r);
+
+        for (int page = 0; page < OLED_PAGES; page++) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            memcpy(&pages[page * OLED_WIDTH + x], &r[page], 8);
+#else
+            for (int k = 0; k < 8; k++)
+                pages[page * OLED_WIDTH + x + k] = r[page] >> (k << 3);
+#endif
+        }
+    }
+}
+
+void canvas_present(const struct canvas *cv)
+{
+    canvas_to_pages(cv, oled_get_buffer());
+}
\ No newline at end of file
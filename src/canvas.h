@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "panel.h"
+
+// column-major canvas
+//
+// each column of the panel (at most 64 pixels tall) is one 64-bit word,
+// bit y of col[x] is pixel (x, y); glyphs and sprites can be placed at
+// any pixel y with one shift-and-mask per column, the page layout the
+// SSD1306 needs is produced by canvas_to_pages() at flush time
+
+struct canvas {
+    uint64_t col[OLED_WIDTH];
+};
+
+void canvas_clear(struct canvas *cv);
+void canvas_draw_pixel(struct canvas *cv, int x, int y);
+void canvas_draw_bitmap_xy(struct canvas *cv, int x, int y, int width, int height, const unsigned char *bitmap);
+void canvas_draw_text_xy(struct canvas *cv, int x, int y, const char *str);
+
+// convert to the controller page layout (OLED_BUFFER_SIZE bytes, see oled.c)
+void canvas_to_pages(const struct canvas *cv, unsigned char *pages);
+
+// copy the canvas into the oled buffer, oled_redraw() sends the changes
+void canvas_present(const struct canvas *cv);
\ No newline at end of file
@@ -0,0 +1,428 @@
+#define _GNU_SOURCE                     // pipe2
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cmd.h"
+
+extern char **environ;
+
+// what the provider's epoll reported, tagged in data.u32
+enum { EV_WAKE, EV_TIMER, EV_OUTPUT, EV_EXIT };
+#define EV_TAG(kind, id)    ((kind) << 16 | (id))
+
+struct command {
+    char command[CMD_COMMAND_MAX];
+    int ttl_ms;
+    int timeout_ms;
+
+    // shared with readers, under the lock
+    char output[CMD_OUTPUT_MAX];
+    int valid;
+    uint64_t fetched_ms;                // last run finished (or failed)
+    int wanted;                         // refresh asked for or running
+
+    // event loop only
+    pid_t pid;                          // 0 = not running
+    int pidfd;
+    int out_fd;                         // -1 after EOF
+    uint64_t deadline_ms;
+    int timed_out;
+    char buf[CMD_OUTPUT_MAX];
+    int len;
+    int line_done;                      // newline seen, the rest is dropped
+};
+
+static struct command commands[CMD_MAX];
+static int command_count = 0;
+static int next_start = 0;              // round robin over wanted commands
+static struct cmd_stats stats;
+static pthread_mutex_t cmd_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int epfd = -1;
+static int wake_fd = -1;
+static int timer_fd = -1;
+
+static uint64_t monotonic_ms()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int watch(int fd, int kind, int id)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = EV_TAG(kind, id) };
+
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int cmd_register(const char *command, int ttl_ms, int timeout_ms)
+{
+    struct command *c;
+
+    if (command_count == CMD_MAX || strlen(command) >= CMD_COMMAND_MAX)
+        return -1;
+
+    c = &commands[command_count];
+    memset(c, 0, sizeof(*c));
+    strcpy(c->command, command);
+    c->ttl_ms = ttl_ms;
+    c->timeout_ms = timeout_ms;
+    c->pidfd = -1;
+    c->out_fd = -1;
+
+    return command_count++;
+}
+
+int cmd_get(int id, char *out, size_t out_size)
+{
+    struct command *c;
+    uint64_t one = 1;
+    int fresh;
+
+    if (id < 0 || id >= command_count) {
+        snprintf(out, out_size, "%s", "");
+        return 0;
+    }
+    c = &commands[id];
+
+    pthread_mutex_lock(&cmd_lock);
+
+    snprintf(out, out_size, "%s", c->valid ? c->output : "");
+    fresh = c->valid && monotonic_ms() - c->fetched_ms < (uint64_t)c->ttl_ms;
+    if (fresh) {
+        stats.hits++;
+    } else {
+        stats.stale++;
+        if (!c->wanted) {
+            c->wanted = 1;
+            if (wake_fd != -1)
+                write(wake_fd, &one, sizeof(one));
+        }
+    }
+
+    pthread_mutex_unlock(&cmd_lock);
+
+    return fresh;
+}
+
+static int spawn(struct command *c)
+{
+    // /bin/sh -c command in its own process group, stdout into a
+    // non-blocking pipe, stdin and stderr on /dev/null, signals unblocked
+
+    char *argv[] = { "sh", "-c", c->command, NULL };
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    sigset_t none;
+    int pipefd[2];
+    int rc;
+
+    if (pipe2(pipefd, O_NONBLOCK | O_CLOEXEC) < 0)
+        return -1;
+
+    sigemptyset(&none);
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, pipefd[1], 1);
+    posix_spawn_file_actions_addopen(&fa, 2, "/dev/null", O_WRONLY, 0);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setsigmask(&attr, &none);
+
+    rc = posix_spawn(&c->pid, "/bin/sh", &fa, &attr, argv, environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+    close(pipefd[1]);
+
+    if (rc != 0) {
+        c->pid = 0;
+        close(pipefd[0]);
+        return -1;
+    }
+
+    // the exit is watched through a pidfd, so reaping needs no SIGCHLD
+    c->pidfd = syscall(SYS_pidfd_open, c->pid, 0);
+    c->out_fd = pipefd[0];
+    if (c->pidfd < 0 || watch(c->pidfd, EV_EXIT, c - commands)
+        || watch(c->out_fd, EV_OUTPUT, c - commands)) {
+        kill(-c->pid, SIGKILL);
+        waitpid(c->pid, NULL, 0);
+        if (c->pidfd >= 0)
+            close(c->pidfd);
+        close(c->out_fd);
+        c->pid = 0;
+        c->pidfd = c->out_fd = -1;
+        return -1;
+    }
+
+    c->deadline_ms = monotonic_ms() + c->timeout_ms;
+    c->timed_out = 0;
+    c->len = 0;
+    c->line_done = 0;
+
+    pthread_mutex_lock(&cmd_lock);
+    stats.spawned++;
+    pthread_mutex_unlock(&cmd_lock);
+
+    return 0;
+}
+
+static void close_output(struct command *c)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->out_fd, NULL);
+    close(c->out_fd);
+    c->out_fd = -1;
+}
+
+static void drain(struct command *c)
+{
+    // keep the first line, read and drop the rest so the child never
+    // blocks on a full pipe; closes the pipe at EOF
+
+    char tmp[256];
+    ssize_t n;
+
+    while ((n = read(c->out_fd, tmp, sizeof(tmp))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                return;
+            break;
+        }
+        for (ssize_t i = 0; i < n && !c->line_done; i++) {
+            if (tmp[i] == '\n')
+                c->line_done = 1;
+            else if (c->len < CMD_OUTPUT_MAX - 1)
+                c->buf[c->len++] = tmp[i];
+        }
+    }
+
+    close_output(c);
+}
+
+static int finish(struct command *c)
+{
+    // the child exited: reap it and cache its output if it succeeded,
+    // returns 1 when the cached output changed
+
+    int status = 0;
+    int changed = 0;
+
+    // what the child wrote is in the pipe by now, but a background
+    // grandchild may hold its write end open long after; the pipe is not
+    // waited on past this read
+    if (c->out_fd != -1)
+        drain(c);
+    if (c->out_fd != -1)
+        close_output(c);
+
+    waitpid(c->pid, &status, WNOHANG);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->pidfd, NULL);
+    close(c->pidfd);
+    c->pidfd = -1;
+    c->pid = 0;
+
+    c->buf[c->len] = '\0';
+
+    pthread_mutex_lock(&cmd_lock);
+    if (c->timed_out) {
+        stats.timeouts++;
+    } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        stats.failed++;
+    } else {
+        changed = !c->valid || strcmp(c->output, c->buf);
+        strcpy(c->output, c->buf);
+        c->valid = 1;
+        stats.completed++;
+    }
+    // a failed run is retried once the TTL has passed again
+    c->fetched_ms = monotonic_ms();
+    c->wanted = 0;
+    pthread_mutex_unlock(&cmd_lock);
+
+    return changed;
+}
+
+static void start_wanted()
+{
+    int running = 0;
+    int wanted[CMD_MAX];
+
+    for (int i = 0; i < command_count; i++)
+        running += commands[i].pid != 0;
+
+    pthread_mutex_lock(&cmd_lock);
+    for (int i = 0; i < command_count; i++)
+        wanted[i] = commands[i].wanted;
+    pthread_mutex_unlock(&cmd_lock);
+
+    for (int k = 0; k < command_count && running < CMD_RUNNING_MAX; k++) {
+        int i = (next_start + k) % command_count;
+        struct command *c = &commands[i];
+
+        if (!wanted[i] || c->pid)
+            continue;
+
+        if (spawn(c) == 0) {
+            running++;
+        } else {
+            pthread_mutex_lock(&cmd_lock);
+            stats.failed++;
+            c->fetched_ms = monotonic_ms();
+            c->wanted = 0;
+            pthread_mutex_unlock(&cmd_lock);
+        }
+        next_start = (i + 1) % command_count;
+    }
+}
+
+static void arm_deadline()
+{
+    // the timer follows the earliest deadline of a child not yet killed
+
+    struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+    uint64_t first = 0;
+
+    for (int i = 0; i < command_count; i++) {
+        struct command *c = &commands[i];
+
+        if (c->pid && !c->timed_out && (!first || c->deadline_ms < first))
+            first = c->deadline_ms;
+    }
+
+    if (first) {
+        its.it_value.tv_sec = first / 1000;
+        its.it_value.tv_nsec = first % 1000 * 1000000;
+    }
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void kill_overdue()
+{
+    uint64_t now = monotonic_ms();
+
+    for (int i = 0; i < command_count; i++) {
+        struct command *c = &commands[i];
+
+        if (c->pid && !c->timed_out && now >= c->deadline_ms) {
+            kill(-c->pid, SIGKILL);
+            c->timed_out = 1;
+        }
+    }
+}
+
+int cmd_open()
+{
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    pthread_mutex_lock(&cmd_lock);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_mutex_unlock(&cmd_lock);
+
+    if (epfd == -1 || timer_fd == -1 || wake_fd == -1
+        || watch(wake_fd, EV_WAKE, 0) || watch(timer_fd, EV_TIMER, 0)) {
+        cmd_close();
+        return -1;
+    }
+
+    // refreshes asked for before the loop ran
+    start_wanted();
+    arm_deadline();
+
+    return epfd;
+}
+
+void cmd_close()
+{
+    for (int i = 0; i < command_count; i++) {
+        struct command *c = &commands[i];
+
+        if (!c->pid)
+            continue;
+        kill(-c->pid, SIGKILL);
+        waitpid(c->pid, NULL, 0);
+        close(c->pidfd);
+        if (c->out_fd != -1)
+            close(c->out_fd);
+        c->pid = 0;
+        c->pidfd = c->out_fd = -1;
+    }
+
+    pthread_mutex_lock(&cmd_lock);
+    if (wake_fd != -1)
+        close(wake_fd);
+    wake_fd = -1;
+    pthread_mutex_unlock(&cmd_lock);
+
+    if (timer_fd != -1)
+        close(timer_fd);
+    if (epfd != -1)
+        close(epfd);
+    timer_fd = epfd = -1;
+}
+
+unsigned cmd_dispatch()
+{
+    struct epoll_event events[2 * CMD_RUNNING_MAX + 2];
+    unsigned changes = 0;
+    uint64_t count;
+    int n;
+
+    n = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]), 0);
+
+    for (int i = 0; i < n; i++) {
+        int kind = events[i].data.u32 >> 16;
+        struct command *c = &commands[events[i].data.u32 & 0xffff];
+
+        switch (kind) {
+        case EV_WAKE:
+            read(wake_fd, &count, sizeof(count));
+            break;
+        case EV_TIMER:
+            read(timer_fd, &count, sizeof(count));
+            kill_overdue();
+            break;
+        case EV_OUTPUT:
+            if (c->out_fd != -1)
+                drain(c);
+            break;
+        case EV_EXIT:
+            if (c->pid && finish(c))
+                changes |= 1u << (c - commands);
+            break;
+        }
+    }
+
+    start_wanted();
+    arm_deadline();
+
+    return changes;
+}
+
+void cmd_get_stats(struct cmd_stats *out)
+{
+    pthread_mutex_lock(&cmd_lock);
+    *out = stats;
+    pthread_mutex_unlock(&cmd_lock);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+
+// external command provider
+//
+// commands run through /bin/sh -c, spawned by the event loop and never
+// by the screens; their first output line is cached for a per-command
+// TTL, a read of a stale or missing value returns what is cached and
+// asks for a refresh; at most CMD_RUNNING_MAX children run at once and
+// one that overruns its deadline is killed with its process group
+
+#define CMD_MAX             8           // registered commands
+#define CMD_RUNNING_MAX     2           // children at once
+#define CMD_COMMAND_MAX     128
+#define CMD_OUTPUT_MAX      64          // first line, '\0' included
+
+struct cmd_stats {
+    unsigned long spawned;
+    unsigned long completed;            // exited 0, output cached
+    unsigned long failed;               // spawn errors and non-zero exits
+    unsigned long timeouts;             // killed at the deadline
+    unsigned long hits;                 // reads served within the TTL
+    unsigned long stale;                // reads that asked for a refresh
+};
+
+// register at startup, before any other thread calls cmd_get();
+// returns an id for cmd_get() or -1
+int cmd_register(const char *command, int ttl_ms, int timeout_ms);
+
+// the cached output (empty until the first run completes), returns 1
+// when it is within its TTL, 0 when a refresh was asked for
+int cmd_get(int id, char *out, size_t out_size);
+
+// returns an fd for the event loop to watch, -1 on failure
+int cmd_open();
+
+// kill and reap whatever still runs
+void cmd_close();
+
+// handle what the fd reported, returns the ids whose cached output
+// changed as a mask (bit id)
+unsigned cmd_dispatch();
+
+void cmd_get_stats(struct cmd_stats *stats);
@@ -0,0 +1,146 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "oled.h"
+
+#include "fcache.h"
+
+struct fcache_entry {
+    int used;
+    int screen;
+    uint32_t hash;
+    unsigned long last_use;             // LRU clock
+    unsigned char frame[OLED_BUFFER_SIZE];
+};
+
+static struct fcache_entry entries[FCACHE_MAX_ENTRIES];
+static int capacity = FCACHE_MAX_ENTRIES;
+static unsigned long clock_tick = 0;
+
+// entry the oled buffer holds unchanged since it was stored or restored
+static struct fcache_entry *current = NULL;
+static unsigned long current_generation;
+
+// bumped by the render thread, read from any thread
+static struct {
+    atomic_ulong hits;
+    atomic_ulong misses;
+    atomic_ulong shown;
+    atomic_ulong evictions;
+} stats;
+
+static struct fcache_entry *find(int screen, uint32_t hash)
+{
+    for (int i = 0; i < capacity; i++)
+        if (entries[i].used && entries[i].screen == screen && entries[i].hash == hash)
+            return &entries[i];
+
+    return NULL;
+}
+
+int fcache_lookup(int screen, uint32_t hash)
+{
+    // look a frame up and restore it into the oled buffer on a hit
+    //
+    // returns FCACHE_MISS, FCACHE_HIT or FCACHE_SHOWN (see fcache.h)
+
+    struct fcache_entry *e = find(screen, hash);
+
+    if (!e) {
+        atomic_fetch_add_explicit(&stats.misses, 1, memory_order_relaxed);
+        return FCACHE_MISS;
+    }
+
+    atomic_fetch_add_explicit(&stats.hits, 1, memory_order_relaxed);
+    e->last_use = ++clock_tick;
+
+    // nothing was drawn since this frame went into the buffer
+    if (e == current && oled_get_generation() == current_generation) {
+        atomic_fetch_add_explicit(&stats.shown, 1, memory_order_relaxed);
+        return FCACHE_SHOWN;
+    }
+
+    memcpy(oled_get_buffer(), e->frame, sizeof(e->frame));
+    current = e;
+    current_generation = oled_get_generation();
+
+    return FCACHE_HIT;
+}
+
+void fcache_store(int screen, uint32_t hash)
+{
+    // keep the frame just rendered into the oled buffer
+
+    struct fcache_entry *e = find(screen, hash);
+
+    if (!e) {
+        e = &entries[0];
+        for (int i = 0; i < capacity; i++) {
+            if (!entries[i].used) {
+                e = &entries[i];
+                break;
+            }
+            if (entries[i].last_use < e->last_use)
+                e = &entries[i];
+        }
+        if (e->used)
+            atomic_fetch_add_explicit(&stats.evictions, 1, memory_order_relaxed);
+    }
+
+    e->used = 1;
+    e->screen = screen;
+    e->hash = hash;
+    e->last_use = ++clock_tick;
+    memcpy(e->frame, oled_get_buffer(), sizeof(e->frame));
+
+    current = e;
+    current_generation = oled_get_generation();
+}
+
+void fcache_invalidate(int screen)
+{
+    // drop every frame of a screen (-1 = all screens)
+
+    for (int i = 0; i < FCACHE_MAX_ENTRIES; i++)
+        if (screen < 0 || entries[i].screen == screen)
+            entries[i].used = 0;
+
+    current = NULL;
+}
+
+void fcache_set_capacity(int entries_max)
+{
+    // bound the cache to entries_max frames (1 .. FCACHE_MAX_ENTRIES)
+
+    if (entries_max < 1)
+        entries_max = 1;
+    if (entries_max > FCACHE_MAX_ENTRIES)
+        entries_max = FCACHE_MAX_ENTRIES;
+
+    for (int i = entries_max; i < capacity; i++)
+        entries[i].used = 0;
+    if (current && current - entries >= entries_max)
+        current = NULL;
+
+    capacity = entries_max;
+}
+
+void fcache_get_stats(struct fcache_stats *st)
+{
+    st->hits = atomic_load_explicit(&stats.hits, memory_order_relaxed);
+    st->misses = atomic_load_explicit(&stats.misses, memory_order_relaxed);
+    st->shown = atomic_load_explicit(&stats.shown, memory_order_relaxed);
+    st->evictions = atomic_load_explicit(&stats.evictions, memory_order_relaxed);
+}
+
+uint32_t fcache_hash(const void *data, size_t len, uint32_t seed)
+{
+    const unsigned char *p = data;
+
+    for (size_t i = 0; i < len; i++) {
+        seed ^= p[i];
+        seed *= 16777619u;
+    }
+
+    return seed;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// full-frame render cache
+//
+// finished frames are kept by (screen id, content hash), a hit restores
+// the frame into the oled buffer instead of rasterizing it again; the
+// cache is a fixed pool of frames replaced in LRU order
+
+#define FCACHE_MAX_ENTRIES  8           // one frame each
+
+#define FCACHE_MISS     0               // render, fcache_store(), oled_redraw()
+#define FCACHE_HIT      1               // frame restored, oled_redraw()
+#define FCACHE_SHOWN    2               // buffer already holds it, nothing to do
+
+struct fcache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long shown;                // hits that skipped the flush too
+    unsigned long evictions;
+};
+
+int fcache_lookup(int screen, uint32_t hash);
+void fcache_store(int screen, uint32_t hash);
+void fcache_invalidate(int screen);
+void fcache_set_capacity(int entries);
+void fcache_get_stats(struct fcache_stats *stats);
+
+// FNV-1a, chainable through seed (start with FCACHE_HASH_SEED)
+#define FCACHE_HASH_SEED    2166136261u
+uint32_t fcache_hash(const void *data, size_t len, uint32_t seed);
\ No newline at end of file
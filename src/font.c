@@ -1,3 +1,10 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "oled.h"
+
+#include "font.h"
+
 unsigned char ascii_font_2x8[95][16] = {
     {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// " "
     {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x33, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// "!"
@@ -94,4 +101,134 @@ unsigned char ascii_font_2x8[95][16] = {
     {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// "|"
     {0x02, 0x40, 0x02, 0x40, 0xFC, 0x3E, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	// "}"
     {0x00, 0x00, 0x02, 0x00, 0x01, 0x00, 0x02, 0x00, 0x02, 0x00, 0x04, 0x00, 0x02, 0x00, 0x00, 0x00},	// "~"
-};
\ No newline at end of file
+};
+
+static const struct font_glyph *glyph(const struct font *f, unsigned char c)
+{
+    if (c < f->first || c > f->last || !f->glyphs[c - f->first].advance)
+        return NULL;
+
+    return &f->glyphs[c - f->first];
+}
+
+int font_text_width(const struct font *f, const char *str)
+{
+    int width = 0;
+
+    for (; *str; str++) {
+        const struct font_glyph *g = glyph(f, *str);
+
+        if (g)
+            width += g->advance;
+    }
+
+    return width;
+}
+
+int font_fit(const struct font *f, const char *str, int width)
+{
+    // number of leading characters of str that fit into width pixels
+
+    int n = 0;
+
+    for (; str[n]; n++) {
+        const struct font_glyph *g = glyph(f, str[n]);
+
+        if (g && (width -= g->advance) < 0)
+            break;
+    }
+
+    return n;
+}
+
+static const uint8_t *shifted(struct font *f, int shift)
+{
+    // the font's columns moved down by shift rows, stride bytes each
+
+    int nbytes = (f->height + 7) >> 3;
+    int stride = font_stride(f, shift);
+    uint8_t *out;
+
+    if (f->shifted[shift])
+        return f->shifted[shift];
+
+    out = malloc((size_t)f->columns * stride);
+    if (!out)
+        return NULL;
+
+    for (int c = 0; c < f->columns; c++) {
+        uint64_t bits = 0;
+
+        for (int k = 0; k < nbytes; k++)
+            bits |= (uint64_t)f->bitmap[c * nbytes + k] << (k << 3);
+        bits <<= shift;
+        for (int k = 0; k < stride; k++)
+            out[c * stride + k] = bits >> (k << 3);
+    }
+
+    f->shifted[shift] = out;
+
+    return out;
+}
+
+int font_stride(const struct font *f, int shift)
+{
+    return (f->height + shift + 7) >> 3;
+}
+
+int font_draw_text(struct font *f, int x, int y, const char *str)
+{
+    int shift = y & 7;
+    int stride = font_stride(f, shift);
+    uint64_t cell = ((1ULL << f->height) - 1) << shift;
+    unsigned char mask[5];
+    const uint8_t *cols = shifted(f, shift);
+
+    if (!cols)
+        return x;
+
+    // rows of the cell on each page, the rest of the page stays
+    for (int k = 0; k < stride; k++)
+        mask[k] = cell >> (k << 3);
+
+    for (; *str && x < OLED_WIDTH; str++) {
+        const struct font_glyph *g = glyph(f, *str);
+
+        if (!g)
+            continue;
+
+        oled_blit_columns(x, y >> 3, g->width, stride, cols + g->offset * stride, mask);
+        x += g->advance;
+    }
+
+    return x;
+}
+
+int font_rasterize(struct font *f, int shift, const char *str, unsigned char *out, int columns)
+{
+    // glyph columns are copied out of the shifted cache whole, a later
+    // glyph overwrites the overhang of the one before
+
+    int stride = font_stride(f, shift);
+    const uint8_t *cols = shifted(f, shift);
+    int x = 0, used = 0;
+
+    if (!cols)
+        return 0;
+
+    for (; *str && x < columns; str++) {
+        const struct font_glyph *g = glyph(f, *str);
+        int width;
+
+        if (!g)
+            continue;
+
+        width = (x + g->width > columns) ? columns - x : g->width;
+        memcpy(out + x * stride, cols + g->offset * stride, width * stride);
+        if (x + width > used)
+            used = x + width;
+        x += g->advance;
+    }
+
+    return used;
+}
@@ -1,3 +1,49 @@
 #pragma once
 
-extern unsigned char ascii_font_2x8[95][16];
\ No newline at end of file
+#include <stdint.h>
+
+extern unsigned char ascii_font_2x8[95][16];
+
+// font engine
+//
+// fonts are converted from fonts/*.bdf at build time (tools/bdf2c.py)
+// into packed column tables in the controller layout, with a
+// proportional advance per glyph; the first time a font is drawn at a
+// sub-page offset (y & 7) its columns are shifted once into a per-font
+// cache, after that text at any pixel row is a masked byte store per
+// column and page, no per-pixel work
+
+struct font_glyph {
+    uint16_t offset;                    // first column in bitmap
+    uint8_t width;                      // stored columns, the advance unless ink overhangs
+    uint8_t advance;                    // pen advance in pixels, 0 = no glyph
+};
+
+struct font {
+    const char *name;
+    int height;                         // pixel rows, at most 32
+    int first, last;                    // character codes covered by glyphs
+    int columns;                        // columns in bitmap
+    const struct font_glyph *glyphs;
+    const uint8_t *bitmap;              // (height + 7) / 8 bytes per column, top row in the LSB
+
+    uint8_t *shifted[8];                // columns moved down by 0..7 rows, built on first use
+};
+
+// generated from fonts/6x8.bdf, fonts/8x16.bdf and fonts/digits32.bdf
+extern struct font font_6x8;
+extern struct font font_8x16;
+extern struct font font_digits32;
+
+int font_text_width(const struct font *f, const char *str);
+int font_fit(const struct font *f, const char *str, int width);
+
+// draw opaque text with its top left at pixel (x, y), returns the pen x
+// after the last glyph; characters without a glyph are skipped
+int font_draw_text(struct font *f, int x, int y, const char *str);
+
+// rasterize into column-major memory instead of the oled buffer: text
+// moved down by shift rows (y & 7), font_stride() bytes per column, at
+// most columns wide; returns the columns written
+int font_stride(const struct font *f, int shift);
+int font_rasterize(struct font *f, int shift, const char *str, unsigned char *out, int columns);
@@ -1,7 +1,9 @@
 #include <linux/gpio.h>
 #include <sys/ioctl.h>
 
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -11,10 +13,27 @@
 
 #define CONSUMER "gpio-tools"
 
+// line-handle pool
+//
+// a line request is kept open once made, so repeated gets and sets are
+// one ioctl on the request fd and outputs keep their value between
+// calls (the kernel resets released lines); handles are matched by chip
+// and line offsets in order
+static struct gpio_handle pool[GPIO_POOL_SIZE];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
 int gpio_request_line(char *dev, int *lines, int count, struct gpio_v2_line_config *config, int *fd)
 {
     // request GPIO lines in a GPIO chip
 
+    return gpio_request_events(dev, lines, count, config, 0, fd);
+}
+
+int gpio_request_events(char *dev, int *lines, int count, struct gpio_v2_line_config *config, int buffer_size, int *fd)
+{
+    // request GPIO lines with room for buffer_size edge events in the
+    // kernel (0 = the kernel default, 16 per line)
+
     struct gpio_v2_line_request req;
     char pathname[255];
     int i;
@@ -40,10 +59,14 @@ int gpio_request_line(char *dev, int *lines, int count, struct gpio_v2_line_conf
     req.config = *config;
     strcpy(req.consumer, CONSUMER);
     req.num_lines = count;
+    req.event_buffer_size = buffer_size;
 
     // request the GPIO lines in the chip
-    if (ioctl(*fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+    if (ioctl(*fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0) {
+        close(*fd);
+        *fd = -1;
         return EXIT_FAILURE;
+    }
 
     // close GPIO character device file
     if (close(*fd) < 0)
@@ -84,6 +107,154 @@ int gpio_release_line(int fd)
     return EXIT_SUCCESS;
 }
 
+int gpio_read_events(int fd, struct gpio_event_ring *r)
+{
+    // drain the request straight into the ring's free space, as many
+    // events per read() as fit contiguously; what does not fit stays in
+    // the kernel buffer for the next call
+
+    unsigned start = r->head;
+    ssize_t rc;
+
+    while (r->head - r->tail < GPIO_EVENT_RING) {
+        unsigned at = r->head & (GPIO_EVENT_RING - 1);
+        unsigned room = GPIO_EVENT_RING - (r->head - r->tail);
+
+        if (room > GPIO_EVENT_RING - at)
+            room = GPIO_EVENT_RING - at;
+
+        rc = read(fd, &r->events[at], room * sizeof(r->events[0]));
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                break;
+            return -1;
+        }
+        if (rc % sizeof(r->events[0]))
+            return -1;
+
+        rc /= sizeof(r->events[0]);
+        if (rc == 0)
+            break;
+        r->reads++;
+
+        for (unsigned i = at; i < at + rc; i++) {
+            uint32_t seqno = r->events[i].seqno;
+
+            if (r->seqno && seqno - r->seqno > 1)
+                r->dropped += seqno - r->seqno - 1;
+            r->seqno = seqno;
+        }
+        r->head += rc;
+
+        // a short read means the kernel buffer is empty
+        if ((unsigned)rc < room)
+            break;
+    }
+
+    r->received += r->head - start;
+
+    return r->head - start;
+}
+
+int gpio_next_event(struct gpio_event_ring *r, struct gpio_v2_line_event *event)
+{
+    if (r->tail == r->head)
+        return 0;
+
+    *event = r->events[r->tail++ & (GPIO_EVENT_RING - 1)];
+
+    return 1;
+}
+
+static int handle_match(const struct gpio_handle *h, const char *dev, const int *lines, int count)
+{
+    if (!h->count || h->count != count || strcmp(h->dev, dev))
+        return 0;
+
+    for (int i = 0; i < count; i++)
+        if (h->lines[i] != lines[i])
+            return 0;
+
+    return 1;
+}
+
+int gpio_pool_request(char *dev, int *lines, int count, struct gpio_v2_line_config *config, struct gpio_handle **h)
+{
+    // a handle for lines of dev, requested with config unless the pool
+    // holds one already (which keeps its configuration, see
+    // gpio_handle_reconfigure)
+
+    struct gpio_handle *free_slot = NULL;
+    int rc = EXIT_FAILURE;
+
+    if (count <= 0 || count > GPIO_V2_LINES_MAX || strlen(dev) >= sizeof(pool[0].dev))
+        return EXIT_FAILURE;
+
+    pthread_mutex_lock(&pool_lock);
+
+    for (int i = 0; i < GPIO_POOL_SIZE; i++) {
+        if (handle_match(&pool[i], dev, lines, count)) {
+            *h = &pool[i];
+            rc = EXIT_SUCCESS;
+            break;
+        }
+        if (!free_slot && !pool[i].count)
+            free_slot = &pool[i];
+    }
+
+    if (rc != EXIT_SUCCESS && free_slot
+        && gpio_request_line(dev, lines, count, config, &free_slot->fd) == EXIT_SUCCESS) {
+        strcpy(free_slot->dev, dev);
+        memcpy(free_slot->lines, lines, count * sizeof(*lines));
+        free_slot->count = count;
+        free_slot->config = *config;
+        *h = free_slot;
+        rc = EXIT_SUCCESS;
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+
+    return rc;
+}
+
+int gpio_handle_reconfigure(struct gpio_handle *h, struct gpio_v2_line_config *config)
+{
+    // change direction, bias, edges or output values without releasing
+    // the lines
+
+    if (ioctl(h->fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, config) < 0)
+        return EXIT_FAILURE;
+
+    h->config = *config;
+
+    return EXIT_SUCCESS;
+}
+
+int gpio_handle_is_output(const struct gpio_handle *h)
+{
+    return !!(h->config.flags & GPIO_V2_LINE_FLAG_OUTPUT);
+}
+
+void gpio_pool_release(struct gpio_handle *h)
+{
+    // give the lines back, outputs return to the kernel's default
+
+    pthread_mutex_lock(&pool_lock);
+    if (h->count) {
+        gpio_release_line(h->fd);
+        memset(h, 0, sizeof(*h));
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void gpio_pool_release_all()
+{
+    for (int i = 0; i < GPIO_POOL_SIZE; i++)
+        gpio_pool_release(&pool[i]);
+}
+
 int gpio_get(char *dev, int line, int *value)
 {
     // get value from specific line
@@ -96,28 +267,31 @@ int gpio_get(char *dev, int line, int *value)
 int gpio_getn(char *dev, int *lines, int count, int *values)
 {
     // get values from specific lines
+    //
+    // the lines are requested as inputs on the first call and stay
+    // requested; lines driven through gpio_setn() are read back as they
+    // are driven, without turning them into inputs
 
-    int fd, i;
-    int rc;
+    struct gpio_handle *h;
     struct gpio_v2_line_config config;
     struct gpio_v2_line_values lv;
+    int i;
 
     memset(&config, 0, sizeof(config));
     config.flags = GPIO_V2_LINE_FLAG_INPUT;
-    rc = gpio_request_line(dev, lines, count, &config, &fd);
-
-    if (rc == EXIT_SUCCESS) {
-        for (i = 0; i < count; i++)
-            gpio_set_bit(&lv.mask, i);
-        rc = gpio_get_values(fd, &lv);
-        if (rc == EXIT_SUCCESS)
-            for (i = 0; i < count; i++)
-                values[i] = gpio_test_bit(lv.bits, i);
-    }
+    if (gpio_pool_request(dev, lines, count, &config, &h) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
 
-    rc |= gpio_release_line(fd);
+    // the uapi masks are __aligned_u64, not the helpers' uint64_t
+    memset(&lv, 0, sizeof(lv));
+    lv.mask = count < 64 ? (1ULL << count) - 1 : ~0ULL;
+    if (gpio_get_values(h->fd, &lv) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
 
-    return rc;
+    for (i = 0; i < count; i++)
+        values[i] = gpio_test_bit(lv.bits, i);
+
+    return EXIT_SUCCESS;
 }
 
 int gpio_set(char *dev, int line, int value)
@@ -132,22 +306,36 @@ int gpio_set(char *dev, int line, int value)
 int gpio_setn(char *dev, int *lines, int count, int *values)
 {
     // set values to specific lines
+    //
+    // the first call requests the lines as outputs with the values,
+    // later calls are a single SET_VALUES; lines the pool holds as
+    // inputs are switched to outputs through SET_CONFIG
 
-    int fd, i;
-    int rc;
+    struct gpio_handle *h;
     struct gpio_v2_line_config config;
+    struct gpio_v2_line_values lv;
+    int i;
 
     memset(&config, 0, sizeof(config));
     config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
     config.num_attrs = 1;
     config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    memset(&lv, 0, sizeof(lv));
     for (i = 0; i < count; i++) {
-        gpio_set_bit(&config.attrs[0].mask, i);
-        gpio_assign_bit(&config.attrs[0].attr.values, i, values[i]);
+        __u64 bit = 1ULL << i;
+
+        lv.mask |= bit;
+        if (values[i])
+            lv.bits |= bit;
     }
+    config.attrs[0].mask = lv.mask;
+    config.attrs[0].attr.values = lv.bits;
 
-    rc = gpio_request_line(dev, lines, count, &config, &fd);
-    rc |= gpio_release_line(fd);
+    if (gpio_pool_request(dev, lines, count, &config, &h) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
 
-    return rc;
-}
\ No newline at end of file
+    if (!gpio_handle_is_output(h))
+        return gpio_handle_reconfigure(h, &config);
+
+    return gpio_set_values(h->fd, &lv);
+}
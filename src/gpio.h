@@ -1,17 +1,60 @@
 #pragma once
 
+#include <linux/gpio.h>
+
 #include <stdbool.h>
 #include <stdint.h>
 
 #define GPIO_BUFFER_SIZE 256
+#define GPIO_POOL_SIZE   8
+#define GPIO_EVENT_RING  64             // power of two
+
+// a line request kept open by the pool (see gpio.c)
+struct gpio_handle {
+    int fd;                             // line request
+    char dev[32];
+    int count;                          // 0 = free slot
+    int lines[GPIO_V2_LINES_MAX];
+    struct gpio_v2_line_config config;  // as last applied
+};
+
+// edge events drained from a line request, many per read()
+//
+// seqno counts every event of the request, so a gap means the kernel
+// dropped events (its buffer overflowed before they were read)
+struct gpio_event_ring {
+    struct gpio_v2_line_event events[GPIO_EVENT_RING];
+    unsigned head, tail;                // free running, head = next write
+    uint32_t seqno;                     // last event seen, 0 = none yet
+
+    unsigned long reads;                // read() calls that returned events
+    unsigned long received;             // events read
+    unsigned long dropped;              // events missing from seqno
+};
 
 // GPIO functions
 
 int gpio_request_line(char *dev, int *lines, int count, struct gpio_v2_line_config *config, int *fd);
+int gpio_request_events(char *dev, int *lines, int count, struct gpio_v2_line_config *config, int buffer_size, int *fd);
 int gpio_set_values(int fd, struct gpio_v2_line_values *values);
 int gpio_get_values(int fd, struct gpio_v2_line_values *values);
 int gpio_release_line(int fd);
 
+// read every pending event of a non-blocking request fd into the ring,
+// returns the number of events that arrived or -1 on a read error
+int gpio_read_events(int fd, struct gpio_event_ring *r);
+
+// take the oldest event, returns 0 when the ring is empty
+int gpio_next_event(struct gpio_event_ring *r, struct gpio_v2_line_event *event);
+
+// line-handle pool: request once, then one ioctl per get/set
+int gpio_pool_request(char *dev, int *lines, int count, struct gpio_v2_line_config *config, struct gpio_handle **h);
+int gpio_handle_reconfigure(struct gpio_handle *h, struct gpio_v2_line_config *config);
+int gpio_handle_is_output(const struct gpio_handle *h);
+void gpio_pool_release(struct gpio_handle *h);
+void gpio_pool_release_all();
+
+// pooled: lines stay requested (and outputs driven) between calls
 int gpio_get(char *dev, int line, int *value);
 int gpio_getn(char *dev, int *lines, int count, int *values);
 int gpio_set(char *dev, int line, int value);
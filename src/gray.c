@@ -0,0 +1,82 @@
+#include "font.h"
+#include "oled.h"
+
+#include "gray.h"
+
+static void paint(struct gray *g, int x, uint64_t mask, int level)
+{
+    // set the pixels of mask in column x to level
+
+    g->msb.col[x] = (level & 2) ? g->msb.col[x] | mask : g->msb.col[x] & ~mask;
+    g->lsb.col[x] = (level & 1) ? g->lsb.col[x] | mask : g->lsb.col[x] & ~mask;
+}
+
+void gray_clear(struct gray *g, int level)
+{
+    for (int x = 0; x < OLED_WIDTH; x++)
+        paint(g, x, ~0ULL, level);
+}
+
+void gray_draw_pixel(struct gray *g, int x, int y, int level)
+{
+    // set pixel (x, y) to level, 0 <= level < GRAY_LEVELS
+
+    if (x < 0 || x >= OLED_WIDTH || y < 0 || y >= OLED_HEIGHT)
+        return;
+
+    paint(g, x, 1ULL << y, level);
+}
+
+void gray_fill_rect(struct gray *g, int x, int y, int width, int height, int level)
+{
+    // fill a rectangle (clipped to the panel), one masked word per column
+
+    int x1 = x + width, y1 = y + height;
+    uint64_t mask;
+
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x1 > OLED_WIDTH)
+        x1 = OLED_WIDTH;
+    if (y1 > OLED_HEIGHT)
+        y1 = OLED_HEIGHT;
+    if (x >= x1 || y >= y1)
+        return;
+
+    mask = (y1 - y == 64) ? ~0ULL : ((1ULL << (y1 - y)) - 1) << y;
+
+    for (; x < x1; x++)
+        paint(g, x, mask, level);
+}
+
+void gray_draw_text_xy(struct gray *g, int x, int y, const char *str, int level)
+{
+    // draws a string at any pixel (x, y) in one gray level, 8x16 per char;
+    // only the glyph pixels are painted, the background stays
+
+    if (x < 0 || x >= OLED_WIDTH || y < 0 || y > OLED_HEIGHT - 16)
+        return;
+
+    for (; *str && x <= OLED_WIDTH - 8; str++, x += 8) {
+        const unsigned char *glyph;
+
+        if (*str < 32 || *str > 126)
+            continue;
+
+        glyph = ascii_font_2x8[*str - 32];
+        for (int c = 0; c < 8; c++)
+            paint(g, x + c, (uint64_t)(glyph[2 * c] | (glyph[2 * c + 1] << 8)) << y, level);
+    }
+}
+
+int gray_present(const struct gray *g)
+{
+    unsigned char msb[OLED_BUFFER_SIZE], lsb[OLED_BUFFER_SIZE];
+
+    canvas_to_pages(&g->msb, msb);
+    canvas_to_pages(&g->lsb, lsb);
+
+    return oled_gray_publish(msb, lsb);
+}
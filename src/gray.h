@@ -0,0 +1,26 @@
+#pragma once
+
+#include "canvas.h"
+
+// 2-bit grayscale canvas
+//
+// a gray level 0..3 per pixel, kept as two column-major bit-planes; the
+// panel shows the MSB plane for two subframes and the LSB plane for one
+// (see oled_gray_start), so level 1 is lit a third of the time and
+// level 2 two thirds; only pixels at levels 1 and 2 differ between the
+// planes, which is all a plane switch sends
+
+#define GRAY_LEVELS     4
+
+struct gray {
+    struct canvas msb;
+    struct canvas lsb;
+};
+
+void gray_clear(struct gray *g, int level);
+void gray_draw_pixel(struct gray *g, int x, int y, int level);
+void gray_fill_rect(struct gray *g, int x, int y, int width, int height, int level);
+void gray_draw_text_xy(struct gray *g, int x, int y, const char *str, int level);
+
+// hand both planes to the selected panel, which must be in grayscale mode
+int gray_present(const struct gray *g);
@@ -3,13 +3,68 @@
 #include <sys/ioctl.h>
 
 #include <fcntl.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "i2c.h"
 
+// transfer statistics
+
+#ifdef I2C_STATS
+
+static struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t errors;
+    _Atomic uint64_t total_ns;
+    _Atomic uint64_t hist[I2C_STATS_BUCKETS];
+} op_stats[I2C_OP_COUNT];
+
+static uint64_t stats_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stats_record(enum i2c_op op, uint64_t start, int count, int rc)
+{
+    // account one transfer, relaxed atomics are enough for counters
+
+    uint64_t ns = stats_now() - start;
+    uint64_t us = ns / 1000;
+    int bucket = 0;
+
+    while (us > 1 && bucket < I2C_STATS_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&op_stats[op].count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&op_stats[op].total_ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&op_stats[op].hist[bucket], 1, memory_order_relaxed);
+    if (rc == EXIT_SUCCESS)
+        atomic_fetch_add_explicit(&op_stats[op].bytes, count, memory_order_relaxed);
+    else
+        atomic_fetch_add_explicit(&op_stats[op].errors, 1, memory_order_relaxed);
+}
+
+#define STATS_START()                   stats_now()
+#define STATS_RECORD(op, t, count, rc)  stats_record(op, t, count, rc)
+
+#else
+
+#define STATS_START()                   0
+#define STATS_RECORD(op, t, count, rc)  ((void)(t))
+
+#endif
+
 // helper functions
 
 static int i2c_get_fd(char *dev, int *fd);
@@ -82,41 +137,81 @@ static int i2c_set_device_10bit(int fd, int i2c_addr)
     return EXIT_SUCCESS;
 }
 
-int i2c_write(char *dev, int i2c_addr, unsigned char *buf, int count)
+int i2c_open(char *dev, int i2c_addr, struct i2c_session *s)
 {
-    // generic function to write a buffer to the I2C bus (no in-device address)
+    // open the bus and bind the device address once for the whole session
 
     int rc;
-    int fd;
+
+    s->fd = -1;
+    s->addr = i2c_addr;
 
     // open the file handle
-    rc = i2c_get_fd(dev, &fd);
+    rc = i2c_get_fd(dev, &s->fd);
 
     // set the device address
-    if (rc == EXIT_SUCCESS)
-        rc = i2c_set_device(fd, i2c_addr);
-
-    // perform the write
     if (rc == EXIT_SUCCESS) {
-        // write to the I2C device
-        rc = write(fd, buf, count);
-        if (rc != count)
-            rc = EXIT_FAILURE;
-        else
-            rc = EXIT_SUCCESS;
+        rc = i2c_set_device(s->fd, i2c_addr);
+        if (rc != EXIT_SUCCESS) {
+            i2c_release_fd(s->fd);
+            s->fd = -1;
+        }
     }
 
-    // release the device file handle
-    rc |= i2c_release_fd(fd);
+    return rc;
+}
+
+int i2c_close(struct i2c_session *s)
+{
+    // end the session and release the device file handle
+
+    int rc;
+
+    if (s->fd < 0)
+        return EXIT_SUCCESS;
+
+    rc = i2c_release_fd(s->fd);
+    s->fd = -1;
 
     return rc;
 }
 
-int i2c_write_reg(char *dev, int i2c_addr, int reg, int value)
+static int session_write(struct i2c_session *s, unsigned char *buf, int count)
+{
+    if (write(s->fd, buf, count) != count)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+static int session_read(struct i2c_session *s, unsigned char *buf, int count)
+{
+    // clear the buffer
+    memset(buf, 0, count);
+
+    // read from the I2C device
+    if (read(s->fd, buf, count) != count)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+int i2c_session_write(struct i2c_session *s, unsigned char *buf, int count)
+{
+    // write a buffer to the I2C bus (no in-device address)
+
+    uint64_t t = STATS_START();
+    int rc = session_write(s, buf, count);
+
+    STATS_RECORD(I2C_OP_WRITE, t, count, rc);
+
+    return rc;
+}
+
+int i2c_session_write_reg(struct i2c_session *s, int reg, int value)
 {
     // write a value to the register of the I2C device.
 
-    int rc;
     int count, tmp, i;
     unsigned char buf[I2C_BUFFER_SIZE];
 
@@ -140,65 +235,132 @@ int i2c_write_reg(char *dev, int i2c_addr, int reg, int value)
     }
 
     // write the buffer
-    rc = i2c_write(dev, i2c_addr, buf, count);
-
-    return rc;
+    return i2c_session_write(s, buf, count);
 }
 
-int i2c_write_nreg(char *dev, int i2c_addr, int reg, unsigned char *buf, int count)
+int i2c_session_write_nreg(struct i2c_session *s, int reg, unsigned char *buf, int count)
 {
-    // generic function to write a buffer to the I2C bus
+    // write a buffer to the register of the I2C device
+    //
+    // short transfers are staged on the stack, only oversized ones
+    // need a heap buffer
 
     int rc;
-    unsigned char *buf_new;
+    unsigned char stack_buf[I2C_BUFFER_SIZE];
+    unsigned char *buf_new = stack_buf;
 
     // allocate the new buffer
     count++;            // adding reg to buffer
-    buf_new = malloc(count * sizeof(*buf_new));
+    if (count > I2C_BUFFER_SIZE) {
+        buf_new = malloc(count * sizeof(*buf_new));
+        if (buf_new == NULL)
+            return EXIT_FAILURE;
+    }
 
     // add the address to the data buffer
     buf_new[0] = reg;
     memcpy(&buf_new[1], &buf[0], (count - 1) * sizeof(*buf));
 
     // perform the write
-    rc = i2c_write(dev, i2c_addr, buf_new, count);
+    rc = i2c_session_write(s, buf_new, count);
 
     // free the allocated memory
-    free(buf_new);
+    if (buf_new != stack_buf)
+        free(buf_new);
 
     return rc;
 }
 
-int i2c_read(char *dev, int i2c_addr, unsigned char *buf, int count)
+int i2c_session_read(struct i2c_session *s, unsigned char *buf, int count)
 {
     // read raw bytes from the I2C bus (no in-device address)
 
+    uint64_t t = STATS_START();
+    int rc = session_read(s, buf, count);
+
+    STATS_RECORD(I2C_OP_READ, t, count, rc);
+
+    return rc;
+}
+
+int i2c_session_read_nreg(struct i2c_session *s, int reg, unsigned char *buf, int count)
+{
+    // read data from a register of the I2C device
+
+    uint64_t t = STATS_START();
     int rc;
-    int fd;
 
-    // open the device file handle
-    rc = i2c_get_fd(dev, &fd);
+    // clear the buffer
+    memset(buf, 0, count);
+    // push the address into the buffer
+    buf[0] = (reg & 0xff);
 
-    // set the device address
+    // write to the I2C device, then read data
+    rc = session_write(s, buf, 1);
     if (rc == EXIT_SUCCESS)
-        rc = i2c_set_device(fd, i2c_addr);
+        rc = session_read(s, buf, count);
 
-    // perform the read
-    if (rc == EXIT_SUCCESS) {
-        // read data
-        // clear the buffer
-        memset(buf, 0, count);
-
-        // read from the I2C device
-        rc = read(fd, buf, count);
-        if (rc != count)
-            rc = EXIT_FAILURE;
-        else
-            rc = EXIT_SUCCESS;
-    }
+    STATS_RECORD(I2C_OP_READ_REG, t, 1 + count, rc);
 
-    // release the device file handle
-    rc |= i2c_release_fd(fd);
+    return rc;
+}
+
+int i2c_write(char *dev, int i2c_addr, unsigned char *buf, int count)
+{
+    // generic function to write a buffer to the I2C bus (no in-device address)
+
+    struct i2c_session s;
+    int rc;
+
+    rc = i2c_open(dev, i2c_addr, &s);
+    if (rc == EXIT_SUCCESS)
+        rc = i2c_session_write(&s, buf, count);
+    rc |= i2c_close(&s);
+
+    return rc;
+}
+
+int i2c_write_reg(char *dev, int i2c_addr, int reg, int value)
+{
+    // write a value to the register of the I2C device.
+
+    struct i2c_session s;
+    int rc;
+
+    rc = i2c_open(dev, i2c_addr, &s);
+    if (rc == EXIT_SUCCESS)
+        rc = i2c_session_write_reg(&s, reg, value);
+    rc |= i2c_close(&s);
+
+    return rc;
+}
+
+int i2c_write_nreg(char *dev, int i2c_addr, int reg, unsigned char *buf, int count)
+{
+    // generic function to write a buffer to the I2C bus
+
+    struct i2c_session s;
+    int rc;
+
+    rc = i2c_open(dev, i2c_addr, &s);
+    if (rc == EXIT_SUCCESS)
+        rc = i2c_session_write_nreg(&s, reg, buf, count);
+    rc |= i2c_close(&s);
+
+    return rc;
+}
+
+int i2c_read(char *dev, int i2c_addr, unsigned char *buf, int count)
+{
+    // read raw bytes from the I2C bus (no in-device address)
+
+    struct i2c_session s;
+    int rc;
+
+    rc = i2c_open(dev, i2c_addr, &s);
+    if (rc == EXIT_SUCCESS)
+        rc = i2c_session_read(&s, buf, count);
+    rc |= i2c_close(&s);
 
     return rc;
 }
@@ -221,45 +383,13 @@ int i2c_read_nreg(char *dev, int i2c_addr, int reg, unsigned char *buf, int coun
 {
     // read data from a register of the I2C device
 
+    struct i2c_session s;
     int rc;
-    int fd;
 
-    // open the device file handle
-    rc = i2c_get_fd(dev, &fd);
-
-    // set the device address
+    rc = i2c_open(dev, i2c_addr, &s);
     if (rc == EXIT_SUCCESS)
-        rc = i2c_set_device(fd, i2c_addr);
-
-    // perform the read
-    if (rc == EXIT_SUCCESS) {
-        // set addr
-        // clear the buffer
-        memset(buf, 0, count);
-        // push the address into the buffer
-        buf[0] = (reg & 0xff);
-
-        // write to the I2C device
-        rc = write(fd, buf, 1);
-
-        // read data
-        if (rc != 1)
-            rc = EXIT_FAILURE;
-        else {
-            // clear the buffer
-            memset(buf, 0, count);
-
-            // read from the I2C device
-            rc = read(fd, buf, count);
-            if (rc != count)
-                rc = EXIT_FAILURE;
-            else
-                rc = EXIT_SUCCESS;
-        }
-    }
-
-    // release the device file handle
-    rc |= i2c_release_fd(fd);
+        rc = i2c_session_read_nreg(&s, reg, buf, count);
+    rc |= i2c_close(&s);
 
     return rc;
 }
@@ -282,4 +412,64 @@ int i2c_mask_reg(char *dev, int i2c_addr, int reg, int mask)
     }
 
     return rc;
+}
+
+void i2c_get_stats(enum i2c_op op, struct i2c_op_stats *stats)
+{
+    // snapshot the counters of one operation
+
+    memset(stats, 0, sizeof(*stats));
+
+#ifdef I2C_STATS
+    stats->count = atomic_load_explicit(&op_stats[op].count, memory_order_relaxed);
+    stats->bytes = atomic_load_explicit(&op_stats[op].bytes, memory_order_relaxed);
+    stats->errors = atomic_load_explicit(&op_stats[op].errors, memory_order_relaxed);
+    stats->total_ns = atomic_load_explicit(&op_stats[op].total_ns, memory_order_relaxed);
+    for (int i = 0; i < I2C_STATS_BUCKETS; i++)
+        stats->hist[i] = atomic_load_explicit(&op_stats[op].hist[i], memory_order_relaxed);
+#endif
+}
+
+void i2c_reset_stats()
+{
+#ifdef I2C_STATS
+    for (int op = 0; op < I2C_OP_COUNT; op++) {
+        atomic_store(&op_stats[op].count, 0);
+        atomic_store(&op_stats[op].bytes, 0);
+        atomic_store(&op_stats[op].errors, 0);
+        atomic_store(&op_stats[op].total_ns, 0);
+        for (int i = 0; i < I2C_STATS_BUCKETS; i++)
+            atomic_store(&op_stats[op].hist[i], 0);
+    }
+#endif
+}
+
+void i2c_dump_stats(FILE *fp)
+{
+    // print counters, effective throughput and latency histograms
+
+#ifdef I2C_STATS
+    static const char *names[I2C_OP_COUNT] = { "write", "read", "read_reg" };
+    struct i2c_op_stats st;
+
+    for (int op = 0; op < I2C_OP_COUNT; op++) {
+        i2c_get_stats(op, &st);
+        if (st.count == 0)
+            continue;
+
+        fprintf(fp, "i2c %-8s count=%llu bytes=%llu errors=%llu avg=%lluus rate=%lluB/s\n",
+                names[op],
+                (unsigned long long)st.count,
+                (unsigned long long)st.bytes,
+                (unsigned long long)st.errors,
+                (unsigned long long)(st.total_ns / st.count / 1000),
+                (unsigned long long)(st.total_ns ? st.bytes * 1000000000ULL / st.total_ns : 0));
+
+        for (int i = 0; i < I2C_STATS_BUCKETS; i++)
+            if (st.hist[i])
+                fprintf(fp, "    < %7luus: %llu\n", 2UL << i, (unsigned long long)st.hist[i]);
+    }
+#else
+    fprintf(fp, "i2c stats not compiled in (build with make I2C_STATS=1)\n");
+#endif
 }
\ No newline at end of file
@@ -1,8 +1,31 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdio.h>
+
 #define I2C_BUFFER_SIZE 256
 
-// I2C functions
+// persistent I2C session
+//
+// the device node is opened and the slave address is bound once,
+// every transfer afterwards is a single read()/write() syscall
+
+struct i2c_session {
+    int fd;
+    int addr;
+};
+
+int i2c_open(char *dev, int i2c_addr, struct i2c_session *s);
+int i2c_close(struct i2c_session *s);
+
+int i2c_session_write(struct i2c_session *s, unsigned char *buf, int count);
+int i2c_session_write_reg(struct i2c_session *s, int reg, int value);
+int i2c_session_write_nreg(struct i2c_session *s, int reg, unsigned char *buf, int count);
+
+int i2c_session_read(struct i2c_session *s, unsigned char *buf, int count);
+int i2c_session_read_nreg(struct i2c_session *s, int reg, unsigned char *buf, int count);
+
+// I2C functions (stateless, open/bind/close per call)
 
 int i2c_write(char *dev, int i2c_addr, unsigned char *buf, int count);
 int i2c_write_reg(char *dev, int i2c_addr, int reg, int value);
@@ -12,4 +35,31 @@ int i2c_read(char *dev, int i2c_addr, unsigned char *buf, int count);
 int i2c_read_reg(char *dev, int i2c_addr, int reg, int *value);
 int i2c_read_nreg(char *dev, int i2c_addr, int reg, unsigned char *buf, int count);
 
-int i2c_mask_reg(char *dev, int i2c_addr, int reg, int mask);
\ No newline at end of file
+int i2c_mask_reg(char *dev, int i2c_addr, int reg, int mask);
+
+// transfer statistics
+//
+// compiled in with -DI2C_STATS (make I2C_STATS=1), every session transfer
+// is timed with CLOCK_MONOTONIC and recorded per operation without locks;
+// without it the counters stay zero and recording costs nothing
+
+#define I2C_STATS_BUCKETS 20            // latency bucket n: [2^n, 2^(n+1)) us
+
+enum i2c_op {
+    I2C_OP_WRITE,                       // i2c_write / i2c_session_write
+    I2C_OP_READ,                        // i2c_read / i2c_session_read
+    I2C_OP_READ_REG,                    // i2c_read_nreg / i2c_session_read_nreg
+    I2C_OP_COUNT
+};
+
+struct i2c_op_stats {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t total_ns;
+    uint64_t hist[I2C_STATS_BUCKETS];
+};
+
+void i2c_get_stats(enum i2c_op op, struct i2c_op_stats *stats);
+void i2c_reset_stats();
+void i2c_dump_stats(FILE *fp);
\ No newline at end of file
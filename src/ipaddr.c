@@ -0,0 +1,275 @@
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ipaddr.h"
+
+// the table is written by the event loop and read by the render thread;
+// the lock is uncontended in practice, so a read is no syscall
+static struct ipaddr_entry table[IPADDR_MAX];
+static int entries = 0;
+static char primary[IPADDR_LEN];
+static unsigned long generation = 0;
+static int running = 0;
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int nl_fd = -1;
+static unsigned nl_seq = 0;
+static int dumped = 0;                  // reply to the last dump complete
+
+static int request_dump()
+{
+    // ask for every address, the replies arrive like change events
+
+    struct {
+        struct nlmsghdr nh;
+        struct ifaddrmsg ifa;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifa));
+    req.nh.nlmsg_type = RTM_GETADDR;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = ++nl_seq;
+    dumped = 0;
+    req.ifa.ifa_family = AF_UNSPEC;
+
+    if (send(nl_fd, &req, req.nh.nlmsg_len, 0) < 0)
+        return -1;
+
+    return 0;
+}
+
+static int global(const struct ipaddr_entry *e, int family)
+{
+    return e->family == family && e->scope == RT_SCOPE_UNIVERSE;
+}
+
+static void update_primary()
+{
+    // called with the lock held after the table changed
+
+    const struct ipaddr_entry *best = NULL;
+
+    for (int i = 0; i < entries; i++)
+        if (global(&table[i], AF_INET) && (!best || table[i].ifindex < best->ifindex))
+            best = &table[i];
+
+    for (int i = 0; !best && i < entries; i++)
+        if (global(&table[i], AF_INET6))
+            best = &table[i];
+
+    strcpy(primary, best ? best->addr : "");
+}
+
+static int find(const struct ipaddr_entry *e)
+{
+    for (int i = 0; i < entries; i++)
+        if (table[i].ifindex == e->ifindex && table[i].family == e->family
+            && !strcmp(table[i].addr, e->addr))
+            return i;
+
+    return -1;
+}
+
+static int apply(struct nlmsghdr *nh)
+{
+    // one RTM_NEWADDR/RTM_DELADDR, returns 1 when the table changed
+    //
+    // IPv6 addresses are announced again on every lifetime update, an
+    // entry identical to the one held changes nothing
+
+    struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+    struct rtattr *rta = IFA_RTA(ifa);
+    int len = IFA_PAYLOAD(nh);
+    const void *addr = NULL, *local = NULL;
+    struct ipaddr_entry e;
+    int i, changed = 0;
+
+    if (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)
+        return 0;
+
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFA_ADDRESS)
+            addr = RTA_DATA(rta);
+        else if (rta->rta_type == IFA_LOCAL)
+            local = RTA_DATA(rta);
+    }
+
+    // on point-to-point links IFA_ADDRESS is the peer
+    if (local)
+        addr = local;
+    if (!addr)
+        return 0;
+
+    memset(&e, 0, sizeof(e));
+    e.ifindex = ifa->ifa_index;
+    e.family = ifa->ifa_family;
+    e.prefixlen = ifa->ifa_prefixlen;
+    e.scope = ifa->ifa_scope;
+    inet_ntop(e.family, addr, e.addr, sizeof(e.addr));
+
+    pthread_mutex_lock(&table_lock);
+
+    i = find(&e);
+    if (nh->nlmsg_type == RTM_NEWADDR) {
+        if (i < 0 && entries < IPADDR_MAX)
+            i = entries++;
+        if (i >= 0 && memcmp(&table[i], &e, sizeof(e))) {
+            table[i] = e;
+            changed = 1;
+        }
+    } else if (i >= 0) {
+        table[i] = table[--entries];
+        changed = 1;
+    }
+
+    if (changed) {
+        update_primary();
+        generation++;
+    }
+
+    pthread_mutex_unlock(&table_lock);
+
+    return changed;
+}
+
+int ipaddr_open()
+{
+    // the first dump is read here, so the table is complete before
+    // anything shows it
+
+    struct pollfd pfd;
+    struct sockaddr_nl sa;
+
+    nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (nl_fd < 0)
+        return -1;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+
+    if (bind(nl_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || request_dump() < 0) {
+        close(nl_fd);
+        nl_fd = -1;
+        return -1;
+    }
+
+    pthread_mutex_lock(&table_lock);
+    running = 1;
+    pthread_mutex_unlock(&table_lock);
+
+    pfd.fd = nl_fd;
+    pfd.events = POLLIN;
+    while (!dumped && poll(&pfd, 1, 1000) > 0)
+        if (ipaddr_read() < 0)
+            break;
+
+    return nl_fd;
+}
+
+void ipaddr_close()
+{
+    if (nl_fd < 0)
+        return;
+
+    close(nl_fd);
+    nl_fd = -1;
+
+    pthread_mutex_lock(&table_lock);
+    running = 0;
+    entries = 0;
+    primary[0] = '\0';
+    generation++;
+    pthread_mutex_unlock(&table_lock);
+}
+
+int ipaddr_read()
+{
+    // drain the socket; when the kernel had to drop messages (ENOBUFS)
+    // the table is thrown away and dumped again
+
+    char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int changes = 0;
+
+    while (1) {
+        ssize_t len = recv(nl_fd, buf, sizeof(buf), 0);
+        struct nlmsghdr *nh;
+
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                break;
+            if (errno != ENOBUFS)
+                return -1;
+
+            pthread_mutex_lock(&table_lock);
+            entries = 0;
+            update_primary();
+            generation++;
+            pthread_mutex_unlock(&table_lock);
+            changes++;
+
+            if (request_dump() < 0)
+                return -1;
+            continue;
+        }
+        if (len == 0)
+            break;
+
+        for (nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type == RTM_NEWADDR || nh->nlmsg_type == RTM_DELADDR)
+                changes += apply(nh);
+            else if ((nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR)
+                     && nh->nlmsg_seq == nl_seq)
+                dumped = 1;
+        }
+    }
+
+    return changes;
+}
+
+int ipaddr_primary(char *out, size_t out_size)
+{
+    int rc;
+
+    pthread_mutex_lock(&table_lock);
+    rc = running ? primary[0] != '\0' : -1;
+    snprintf(out, out_size, "%s", primary);
+    pthread_mutex_unlock(&table_lock);
+
+    return rc;
+}
+
+int ipaddr_list(struct ipaddr_entry *out, int max)
+{
+    int n;
+
+    pthread_mutex_lock(&table_lock);
+    n = entries < max ? entries : max;
+    memcpy(out, table, n * sizeof(*out));
+    pthread_mutex_unlock(&table_lock);
+
+    return n;
+}
+
+unsigned long ipaddr_generation()
+{
+    unsigned long g;
+
+    pthread_mutex_lock(&table_lock);
+    g = generation;
+    pthread_mutex_unlock(&table_lock);
+
+    return g;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+
+// interface address tracker
+//
+// an rtnetlink socket subscribed to address changes keeps a table of
+// every IPv4 and IPv6 address, filled by one dump at open and changed
+// only by RTM_NEWADDR/RTM_DELADDR after that; the event loop owns the
+// socket, readers only copy out of the table
+
+#define IPADDR_MAX          16
+#define IPADDR_LEN          46          // INET6_ADDRSTRLEN
+
+struct ipaddr_entry {
+    int ifindex;
+    unsigned char family;               // AF_INET or AF_INET6
+    unsigned char prefixlen;
+    unsigned char scope;                // RT_SCOPE_*
+    char addr[IPADDR_LEN];
+};
+
+// returns the socket to watch for input, -1 on failure
+int ipaddr_open();
+void ipaddr_close();
+
+// apply the pending messages, returns how many changed the table or -1
+int ipaddr_read();
+
+// the address to show (the first global IPv4 one, else the first global
+// IPv6 one, as `hostname -I` lists them), returns 0 when there is none
+// and -1 when the tracker is not running
+int ipaddr_primary(char *out, size_t out_size);
+
+// copy of the table, returns the number of entries
+int ipaddr_list(struct ipaddr_entry *entries, int max);
+
+// changes whenever the table does
+unsigned long ipaddr_generation();
@@ -0,0 +1,78 @@
+#include <string.h>
+
+#include "keys.h"
+
+void keys_init(struct keys *k, int count, uint64_t long_ns, uint64_t double_ns)
+{
+    memset(k, 0, sizeof(*k));
+    k->count = count < KEYS_MAX ? count : KEYS_MAX;
+    k->long_ns = long_ns;
+    k->double_ns = double_ns;
+}
+
+void keys_reset(struct keys *k)
+{
+    memset(k->key, 0, sizeof(k->key));
+}
+
+int keys_edge(struct keys *k, int key, int pressed, uint64_t ns)
+{
+    // a press is reported at once, the second of two quick presses as a
+    // double (which callers still take as a press); a release completes
+    // a long press the deadline did not catch in time
+
+    struct key_state *s;
+    int gesture = KEY_NONE;
+
+    if (key < 0 || key >= k->count)
+        return KEY_NONE;
+    s = &k->key[key];
+
+    if (pressed) {
+        // a press while still held means the release was lost, so it
+        // starts over as a plain press
+        if (s->gesture == KEY_PRESS && !s->held && ns - s->down_ns <= k->double_ns)
+            gesture = KEY_DOUBLE;
+        else
+            gesture = KEY_PRESS;
+        s->down_ns = ns;
+        s->held = 1;
+        s->gesture = gesture;
+    } else if (s->held) {
+        if (s->gesture != KEY_LONG && ns - s->down_ns >= k->long_ns)
+            gesture = s->gesture = KEY_LONG;
+        s->held = 0;
+    }
+
+    return gesture;
+}
+
+uint64_t keys_deadline(const struct keys *k)
+{
+    uint64_t deadline = 0;
+
+    for (int i = 0; i < k->count; i++) {
+        const struct key_state *s = &k->key[i];
+        uint64_t t = s->down_ns + k->long_ns;
+
+        if (s->held && s->gesture != KEY_LONG && (!deadline || t < deadline))
+            deadline = t;
+    }
+
+    return deadline;
+}
+
+int keys_expire(struct keys *k, uint64_t now, int *key)
+{
+    for (int i = 0; i < k->count; i++) {
+        struct key_state *s = &k->key[i];
+
+        if (s->held && s->gesture != KEY_LONG && now - s->down_ns >= k->long_ns) {
+            s->gesture = KEY_LONG;
+            *key = i;
+            return KEY_LONG;
+        }
+    }
+
+    return KEY_NONE;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// key gestures from edge timestamps
+//
+// presses and releases are fed in with the kernel's event time, so a
+// long or double press is measured between the edges themselves, however
+// late the events are read; only a key still held needs a deadline from
+// the caller (keys_deadline(), then keys_expire() when it passes)
+
+#define KEYS_MAX            8
+
+#define KEY_NONE            0
+#define KEY_PRESS           1           // acted on at the press edge
+#define KEY_DOUBLE          2           // second press within double_ns
+#define KEY_LONG            3           // held for long_ns
+
+struct key_state {
+    uint64_t down_ns;                   // last press
+    int held;
+    int gesture;                        // last one reported for this press
+};
+
+struct keys {
+    int count;
+    uint64_t long_ns;
+    uint64_t double_ns;                 // press to press
+    struct key_state key[KEYS_MAX];
+};
+
+void keys_init(struct keys *k, int count, uint64_t long_ns, uint64_t double_ns);
+
+// forget every key, after events were lost
+void keys_reset(struct keys *k);
+
+// a press (pressed = 1) or release edge, returns the gesture it completes
+int keys_edge(struct keys *k, int key, int pressed, uint64_t ns);
+
+// when the next long press completes, 0 = no key held
+uint64_t keys_deadline(const struct keys *k);
+
+// KEY_LONG for a key held past long_ns at now (stored in *key), else KEY_NONE
+int keys_expire(struct keys *k, uint64_t now, int *key);
@@ -0,0 +1,87 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "font.h"
+#include "oled.h"
+
+#include "layout.h"
+
+static void put_cell(struct layout *l, int row, int col, char c)
+{
+    // blit one glyph cell unless it already shows c
+
+    if (row >= LAYOUT_ROWS)
+        return;
+
+    if (c < 32 || c > 126)
+        c = ' ';
+
+    if (l->cells[row][col] == c) {
+        l->glyphs_skipped++;
+        return;
+    }
+
+    oled_draw_char(2, 8, ascii_font_2x8[c - 32], row * 2 * OLED_WIDTH + (col << 3));
+    l->cells[row][col] = c;
+    l->glyphs_drawn++;
+}
+
+static void put_item(struct layout *l, const struct layout_item *it, const char *value)
+{
+    // write value into the cells of an item, padded to its width
+
+    int len = strlen(value);
+    int pad, start;
+
+    if (len > it->width)
+        len = it->width;
+    pad = it->width - len;
+    start = (it->align == LAYOUT_RIGHT) ? pad : 0;
+
+    for (int i = 0; i < it->width && it->col + i < LAYOUT_COLS; i++) {
+        int k = i - start;
+
+        put_cell(l, it->row, it->col + i, (k >= 0 && k < len) ? value[k] : ' ');
+    }
+}
+
+void layout_bake(struct layout *l)
+{
+    // cleared cells show spaces (the space glyph is blank)
+
+    if (l->baked && l->generation == oled_get_generation())
+        return;
+
+    oled_clear_buffer();
+    memset(l->cells, ' ', sizeof(l->cells));
+
+    for (int i = 0; i < l->count; i++)
+        if (l->items[i].text)
+            put_item(l, &l->items[i], l->items[i].text);
+
+    l->baked = 1;
+    l->generation = oled_get_generation();
+}
+
+void layout_set(struct layout *l, int item, const char *value)
+{
+    if (item < 0 || item >= l->count || l->items[item].text)
+        return;
+
+    layout_bake(l);
+    put_item(l, &l->items[item], value ? value : "");
+    l->generation = oled_get_generation();
+}
+
+void layout_setf(struct layout *l, int item, const char *fmt, ...)
+{
+    char value[LAYOUT_COLS + 1];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(value, sizeof(value), fmt, ap);
+    va_end(ap);
+
+    layout_set(l, item, value);
+}
\ No newline at end of file
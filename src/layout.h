@@ -0,0 +1,50 @@
+#pragma once
+
+#include "panel.h"
+
+// text layouts with holes
+//
+// a layout is static text plus dynamic fields on the 16x4 (16x2 on a
+// 32 pixel panel) character grid of the 8x16 font; the static part is
+// drawn once, afterwards a field update re-blits only the glyph cells
+// whose character changed, so the dirty-region flush sends a few bytes
+// per changed digit
+
+#define LAYOUT_COLS     16
+#define LAYOUT_ROWS     (OLED_PAGES / 2)
+
+#define LAYOUT_LEFT      0
+#define LAYOUT_RIGHT     1
+
+struct layout_item {
+    int row;                            // 0..3 (LINE1..LINE4), rows below
+                                        // the panel are not drawn
+    int col;                            // first character column 0..15
+    int width;                          // characters
+    int align;                          // LAYOUT_LEFT / LAYOUT_RIGHT
+    const char *text;                   // static text, NULL for a field
+};
+
+struct layout {
+    const struct layout_item *items;
+    int count;
+
+    // characters currently in the oled buffer, valid while the buffer
+    // generation matches (anything else drawn forces a re-bake)
+    int baked;
+    unsigned long generation;
+    char cells[LAYOUT_ROWS][LAYOUT_COLS];
+
+    unsigned long glyphs_drawn;
+    unsigned long glyphs_skipped;
+};
+
+#define LAYOUT_INIT(items) { (items), sizeof(items) / sizeof((items)[0]) }
+
+// draw the static part if the buffer does not hold this layout anymore
+void layout_bake(struct layout *l);
+
+// set a field (index into items) to a value / printf-formatted value
+void layout_set(struct layout *l, int item, const char *value);
+void layout_setf(struct layout *l, int item, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
\ No newline at end of file
@@ -1,4 +1,6 @@
+#include <poll.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -6,13 +8,26 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
 #include <time.h>
 
 #include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 
 #include "stats.h"
+#include "cmd.h"
+#include "fcache.h"
+#include "font.h"
 #include "gpio.h"
+#include "i2c.h"
+#include "ipaddr.h"
+#include "keys.h"
+#include "layout.h"
+#include "marquee.h"
 #include "oled.h"
 #include "yt.h"
 
@@ -23,9 +38,127 @@
 #define LINE3_OFFSET			    3
 #define DISPLAY_OFF_TIMEOUT		    60
 #define COMMAND_OUTPUT_BUFFER_LEN	(16 + 1)	// 1 line of text + '\0'
+#define IP_LINE_LEN                 (3 + 45 + 1)    // "IP:" + IPv6 + '\0'
 #define DEBOUNCE_PERIOD_US		    100
-
-volatile int exit_thread = 0;
+#define KEY_EVENT_BUFFER            64          // edge events the kernel queues
+#define LONG_PRESS_NS               800000000ULL
+#define DOUBLE_PRESS_NS             350000000ULL
+#define SCREEN_OFF                  -1
+
+#define SCREEN_COUNT                5
+#define SHUTDOWN                    99
+
+// per-screen timing, in seconds
+//
+// refresh:   between redraws while visible, 0 = drawn once per visit
+// max_age:   how old a pre-rendered copy may be when its key is pressed,
+//            -1 = the screen never changes
+// prerender: drawn off-screen ahead of its key; only for screens that
+//            draw in microseconds without blocking and stay fresh long
+//            enough not to wake the render thread while nothing happens
+struct screen_policy {
+    int refresh;
+    int max_age;
+    int prerender;
+};
+
+static const struct screen_policy screens[SCREEN_COUNT] = {
+    { 0,  10, 1 },  // splash (clock)
+    { 0, 300, 0 },  // YouTube stats, a fetch blocks for seconds
+    { 2,   2, 0 },  // system stats, stale before anyone looks
+    { 0,  -1, 1 },  // power off? NO
+    { 0,  -1, 1 },  // power off? YES
+};
+
+// menu graph: the screen each fn key leads to from a screen
+static const int menu[SCREEN_COUNT][LINES_COUNT] = {
+    { 1, 2, 3 },
+    { 0, 2, 3 },
+    { 1, 0, 3 },
+    { 1, 2, 4 },
+    { SHUTDOWN, 4, 3 },
+};
+
+atomic_int exit_thread = 0;
+
+// screen mailbox: the GPIO thread posts, the render thread takes
+//
+// only the latest command matters, so it is a single slot guarded by a
+// sequence count (odd while written); posting never blocks or fails and
+// the reader retries on a torn read; render_wake is an eventfd
+static atomic_uint mailbox_seq = 0;
+static atomic_int mailbox_screen = 0;
+static _Atomic uint64_t mailbox_stamp = 0;
+static int render_wake = -1;
+
+// every return from a blocking wait, idle means neither moves; the
+// render thread's counters are read by print_stats() on the event loop
+static unsigned long loop_wakeups = 0;
+static atomic_ulong render_wakeups = 0;
+
+// pre-rendered screens
+//
+// the screens the fn keys lead to are kept drawn in off-screen canvases
+// (those whose policy allows it), so a key press only copies a canvas and
+// flushes; the canvas pool is the memory cap, and a copy older than its
+// screen's max_age is drawn again; a screen visited once keeps its canvas
+// too, so coming back within max_age needs no fetch either
+struct prerender {
+    int screen;                         // -1 = canvas unused
+    uint64_t sampled_ms;                // when its data was fetched
+    unsigned long last_use;             // LRU clock
+};
+
+static struct prerender canvas_owner[OLED_CANVAS_MAX] = {
+    [0 ... OLED_CANVAS_MAX - 1] = { .screen = -1 }
+};
+static unsigned long canvas_tick = 0;
+
+// counted by the render thread, relaxed atomics like the i2c counters
+struct prerender_stats {
+    atomic_ulong hits;                  // key presses served from a canvas
+    atomic_ulong misses;                // key presses that had to render
+    atomic_ulong renders;               // screens drawn into a canvas
+};
+
+static struct prerender_stats prerender_stats;
+
+// fn key edges, read in batches and timed by their kernel timestamps
+static struct gpio_event_ring key_events;
+static struct keys keys;
+static unsigned long key_doubles = 0;
+
+void print_stats()
+{
+    struct oled_flush_stats st;
+    struct fcache_stats fc;
+    struct cmd_stats cs;
+
+    i2c_dump_stats(stderr);
+    oled_get_flush_stats(&st);
+    fprintf(stderr, "oled frames=%lu full=%lu partial=%lu skipped=%lu coalesced=%lu errors=%lu sent=%luB saved=%luB\n",
+            st.frames, st.full_flushes, st.partial_flushes, st.skipped,
+            st.coalesced, st.errors, st.bytes_sent, st.bytes_saved);
+    if (st.stamped)
+        fprintf(stderr, "key-to-flush n=%lu last=%.2fms avg=%.2fms max=%.2fms\n",
+                st.stamped, st.latency_last_ns / 1e6,
+                st.latency_total_ns / 1e6 / st.stamped,
+                st.latency_max_ns / 1e6);
+    fprintf(stderr, "wakeups loop=%lu render=%lu\n", loop_wakeups,
+            atomic_load_explicit(&render_wakeups, memory_order_relaxed));
+    cmd_get_stats(&cs);
+    fprintf(stderr, "commands spawned=%lu completed=%lu failed=%lu timeouts=%lu hits=%lu stale=%lu\n",
+            cs.spawned, cs.completed, cs.failed, cs.timeouts, cs.hits, cs.stale);
+    fprintf(stderr, "key events=%lu reads=%lu dropped=%lu doubles=%lu\n",
+            key_events.received, key_events.reads, key_events.dropped, key_doubles);
+    fprintf(stderr, "prerender hits=%lu misses=%lu renders=%lu\n",
+            atomic_load_explicit(&prerender_stats.hits, memory_order_relaxed),
+            atomic_load_explicit(&prerender_stats.misses, memory_order_relaxed),
+            atomic_load_explicit(&prerender_stats.renders, memory_order_relaxed));
+    fcache_get_stats(&fc);
+    fprintf(stderr, "fcache hits=%lu misses=%lu shown=%lu evictions=%lu\n",
+            fc.hits, fc.misses, fc.shown, fc.evictions);
+}
 
 void format_number(int v, char* b, size_t n)
 {
@@ -46,236 +179,688 @@ void format_number_str(const char* input, char* out, size_t out_size)
     format_number(v, out, out_size);
 }
 
-char *get_command_output(char *command)
+// the splash clock, a command-backed field (see cmd.h)
+#define CLOCK_COMMAND       "date +%R | awk '{printf \"%15s\", $1}'"
+#define CLOCK_TTL_MS        5000
+#define COMMAND_TIMEOUT_MS  2000
+
+static int clock_cmd = -1;
+
+// YouTube stats screen: labels are baked once, values update per glyph
+enum { YT_VIEWS = 2, YT_SUBS = 4, YT_VIDEOS = 6 };
+
+static const struct layout_item yt_items[] = {
+    { 0, 0, 16, LAYOUT_LEFT,  "Your (>)YT stats" },
+    { 1, 0,  6, LAYOUT_LEFT,  "Views:" },
+    { 1, 6, 10, LAYOUT_RIGHT, NULL },
+    { 2, 0,  5, LAYOUT_LEFT,  "Subs:" },
+    { 2, 5, 11, LAYOUT_RIGHT, NULL },
+    { 3, 0,  7, LAYOUT_LEFT,  "Videos:" },
+    { 3, 7,  9, LAYOUT_RIGHT, NULL },
+};
+static struct layout yt_layout = LAYOUT_INIT(yt_items);
+
+// system stats screen: four preformatted lines
+static const struct layout_item sys_items[] = {
+    { 0, 0, 16, LAYOUT_LEFT, NULL },
+    { 1, 0, 16, LAYOUT_LEFT, NULL },
+    { 2, 0, 16, LAYOUT_LEFT, NULL },
+    { 3, 0, 16, LAYOUT_LEFT, NULL },
+};
+static struct layout sys_layout = LAYOUT_INIT(sys_items);
+
+// system stats screen: the IP address when it does not fit (see main)
+#define MARQUEE_STEP_MS     50          // one column per step, 20 columns/s
+static struct marquee ip_marquee;
+
+void render_splash(const void *clock)
+{
+    oled_clear_buffer();
+    oled_print((char *)clock, LINE1);
+    oled_print("  _  _", LINE1);
+    oled_print(" | \\| |___ ___", LINE2);
+    oled_print(" | .` / -_) _ \\", LINE3);
+    oled_print(" |_|\\_\\___\\___/", LINE4);
+}
+
+void render_power_off(const void *yes)
+{
+    oled_clear_buffer();
+    oled_print("   Power off?   ", LINE1);
+    if (*(const int *)yes) {
+        oled_print("       NO       ", LINE2);
+        oled_print("    -> YES      ", LINE3);
+        oled_print("   F1: confirm  ", LINE4);
+    } else {
+        oled_print("    -> NO       ", LINE2);
+        oled_print("       YES      ", LINE3);
+        oled_print("   F3: toggle   ", LINE4);
+    }
+}
+
+void draw_cached(int screen, uint32_t hash, void (*render)(const void *), const void *arg)
+{
+    // static screens come from the frame cache, and are not even copied
+    // again when the draw target still holds them
+
+    if (fcache_lookup(screen, hash) == FCACHE_MISS) {
+        render(arg);
+        fcache_store(screen, hash);
+    }
+}
+
+void post_screen(int screen, uint64_t stamp)
+{
+    // hand a screen to the render thread and wake it up
+    //
+    // stamp is the time of the key press (CLOCK_MONOTONIC ns, 0 = none)
+
+    unsigned seq = atomic_load_explicit(&mailbox_seq, memory_order_relaxed);
+    uint64_t one = 1;
+
+    atomic_store_explicit(&mailbox_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&mailbox_screen, screen, memory_order_relaxed);
+    atomic_store_explicit(&mailbox_stamp, stamp, memory_order_relaxed);
+    atomic_store_explicit(&mailbox_seq, seq + 2, memory_order_release);
+
+    write(render_wake, &one, sizeof(one));
+}
+
+static int take_screen(unsigned *seen, int *screen, uint64_t *stamp)
+{
+    // fetch the latest posted screen, returns 0 when nothing new arrived
+
+    unsigned s1, s2;
+
+    do {
+        s1 = atomic_load_explicit(&mailbox_seq, memory_order_acquire);
+        *screen = atomic_load_explicit(&mailbox_screen, memory_order_relaxed);
+        *stamp = atomic_load_explicit(&mailbox_stamp, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&mailbox_seq, memory_order_relaxed);
+    } while (s1 != s2 || (s1 & 1));
+
+    if (s1 == *seen)
+        return 0;
+    *seen = s1;
+
+    return 1;
+}
+
+static void wait_for_command(int timeout_ms)
+{
+    // sleep until something is posted or the timeout runs out (-1 = none)
+
+    struct pollfd pfd = { render_wake, POLLIN, 0 };
+    uint64_t n;
+
+    if (poll(&pfd, 1, timeout_ms) > 0)
+        read(render_wake, &n, sizeof(n));
+    atomic_fetch_add_explicit(&render_wakeups, 1, memory_order_relaxed);
+}
+
+static unsigned screen_commands(int screen)
+{
+    // the command outputs a screen shows, as a cmd_dispatch() mask
+
+    switch (screen) {
+    case 0:
+        return clock_cmd >= 0 ? 1u << clock_cmd : 0;
+    }
+    return 0;
+}
+
+void draw_screen(int screen)
+{
+    switch (screen) {
+    case 0: {
+        char clock[COMMAND_OUTPUT_BUFFER_LEN];
+
+        cmd_get(clock_cmd, clock, sizeof(clock));
+        draw_cached(0, fcache_hash(clock, strlen(clock), FCACHE_HASH_SEED), render_splash, clock);
+        break;
+    }
+    case 1:{
+        char *views_raw, *subs_raw, *videos_raw;
+        char views_fmt[17], subs_fmt[17], videos_fmt[17]; // 16 chars + '\0'
+
+        get_channel_statistics(&views_raw, &subs_raw, &videos_raw);
+
+        format_number_str(views_raw, views_fmt, sizeof(views_fmt));
+        format_number_str(subs_raw, subs_fmt, sizeof(subs_fmt));
+        format_number_str(videos_raw, videos_fmt, sizeof(videos_fmt));
+
+        layout_set(&yt_layout, YT_VIEWS, views_fmt);
+        layout_set(&yt_layout, YT_SUBS, subs_fmt);
+        layout_set(&yt_layout, YT_VIDEOS, videos_fmt);
+        break;
+    }
+    case 2: {
+        char line1[IP_LINE_LEN], line2[COMMAND_OUTPUT_BUFFER_LEN];
+        char line3[COMMAND_OUTPUT_BUFFER_LEN], line4[COMMAND_OUTPUT_BUFFER_LEN];
+
+        get_ip(line1, sizeof(line1));               // e.g. "IP:192.168.1.208"
+        get_disk_usage(line2, sizeof(line2));       // e.g. "/:    1.2/14.9GB"
+        get_mem_usage(line3, sizeof(line3));        // e.g. "RAM:   103/481MB"
+        get_temp_and_load(line4, sizeof(line4));    // e.g. "CPU: 24.1% 23.7C"
+
+        // an address too long for the grid (IPv6) scrolls after "IP:"
+        if (strlen(line1) > LAYOUT_COLS) {
+            marquee_set_text(&ip_marquee, line1 + 3);
+            line1[3] = '\0';
+        } else {
+            marquee_set_text(&ip_marquee, "");
+        }
+
+        layout_set(&sys_layout, 0, line1);
+        layout_set(&sys_layout, 1, line2);
+        layout_set(&sys_layout, 2, line3);
+        layout_set(&sys_layout, 3, line4);
+
+        // drawing over the layout makes it bake again next time
+        if (marquee_scrolls(&ip_marquee))
+            marquee_draw(&ip_marquee);
+        break;
+    }
+    case 3:
+    case 4: {
+        int yes = (screen == 4);
+
+        draw_cached(screen, 0, render_power_off, &yes);
+        break;
+    }
+    }
+}
+
+static uint64_t monotonic_ms()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int find_canvas(int screen)
+{
+    for (int c = 0; c < OLED_CANVAS_MAX; c++)
+        if (canvas_owner[c].screen == screen)
+            return c;
+
+    return -1;
+}
+
+static int64_t time_left(int c, uint64_t now)
 {
-    // read out command output
-    FILE *fd = popen(command, "r");
-    if (fd == NULL)
-        return NULL;
+    // ms until a canvas goes stale, -1 = never
 
-    // put output into a string (static memory)
-    static char buffer[COMMAND_OUTPUT_BUFFER_LEN];
-    fgets(buffer, COMMAND_OUTPUT_BUFFER_LEN, fd);
+    int max_age = screens[canvas_owner[c].screen].max_age;
 
-    pclose(fd);
+    if (max_age < 0)
+        return -1;
+    if (now >= canvas_owner[c].sampled_ms + max_age * 1000)
+        return 0;
 
-    return buffer;
+    return canvas_owner[c].sampled_ms + max_age * 1000 - now;
 }
 
-void print_stat_line(const char* label, const char* value, int line)
+static int render_canvas(int screen, int keep)
 {
-    char buffer[17]; // 16 znaków + null-terminator
-    int label_len = strlen(label);
-    int value_len = strlen(value);
-    int spaces = 16 - label_len - value_len;
-
-    if (spaces < 0) spaces = 0; // zabezpieczenie, gdyby coś się nie zmieściło
-    snprintf(buffer, sizeof(buffer), "%s%*s%s", label, spaces, "", value);
-    oled_print(buffer, line);
+    // sample a screen and draw it into its canvas, taking over the least
+    // recently used one (except keep's) when it has none
+
+    int c = find_canvas(screen);
+
+    if (c < 0) {
+        for (int i = 0; i < OLED_CANVAS_MAX; i++) {
+            if (keep >= 0 && canvas_owner[i].screen == keep)
+                continue;
+            if (c < 0 || canvas_owner[i].last_use < canvas_owner[c].last_use)
+                c = i;
+        }
+        canvas_owner[c].screen = screen;
+    }
+
+    oled_select_canvas(c);
+    draw_screen(screen);
+    oled_select_canvas(OLED_DISPLAY);
+
+    canvas_owner[c].sampled_ms = monotonic_ms();
+    canvas_owner[c].last_use = ++canvas_tick;
+    atomic_fetch_add_explicit(&prerender_stats.renders, 1, memory_order_relaxed);
+
+    return c;
 }
 
-void *draw_screen(void *arg)
+static void show(int screen, uint64_t stamp, int refresh)
 {
-    int *cmd_index = arg;
-    time_t current_time = time(NULL);
-    time_t display_refresh_time = 0;
-    time_t display_off_time = current_time + DISPLAY_OFF_TIMEOUT;
+    // bring a screen on, from its canvas while that is fresh enough
+
+    int c = find_canvas(screen);
+    unsigned long gen;
+
+    if (c >= 0 && !refresh && time_left(c, monotonic_ms()) != 0) {
+        atomic_fetch_add_explicit(&prerender_stats.hits, 1, memory_order_relaxed);
+    } else {
+        if (!refresh)
+            atomic_fetch_add_explicit(&prerender_stats.misses, 1, memory_order_relaxed);
+        c = render_canvas(screen, -1);
+    }
+    canvas_owner[c].last_use = ++canvas_tick;
+
+    // nothing to flush when the display already shows it
+    gen = oled_get_generation();
+    oled_present_canvas(c);
+    if (oled_get_generation() != gen) {
+        oled_set_frame_stamp(stamp);
+        oled_redraw();
+    }
+}
+
+static int prerender(int screen, unsigned seen)
+{
+    // draw the screens reachable from screen that are missing or stale,
+    // stopping as soon as a command arrives; returns ms until the next
+    // copy goes stale, -1 = none will
+
+    int timeout = -1;
+
+    // neighbors already drawn count as used, so none of them is the one
+    // given up for another neighbor
+    for (int k = 0; k < LINES_COUNT; k++) {
+        int c = find_canvas(menu[screen][k]);
+
+        if (c >= 0)
+            canvas_owner[c].last_use = ++canvas_tick;
+    }
+
+    for (int k = 0; k < LINES_COUNT; k++) {
+        int next = menu[screen][k];
+        int c;
+        int64_t left;
+
+        if (next == SHUTDOWN || next == screen || !screens[next].prerender)
+            continue;
+
+        if (atomic_load(&mailbox_seq) != seen)
+            return 0;
+
+        c = find_canvas(next);
+        if (c < 0 || time_left(c, monotonic_ms()) == 0)
+            c = render_canvas(next, screen);
+
+        left = time_left(c, monotonic_ms());
+        if (left >= 0 && (timeout < 0 || left < timeout))
+            timeout = left;
+    }
+
+    return timeout;
+}
+
+static int step_marquee(uint64_t *due, int timeout)
+{
+    // move the IP marquee on when its step is due, returns the wait until
+    // the next step or timeout, whichever comes first
+
+    uint64_t now = monotonic_ms();
+
+    if (now >= *due) {
+        marquee_step(&ip_marquee, 1);
+        oled_redraw();
+        *due = now + MARQUEE_STEP_MS;
+    }
+
+    if (timeout < 0 || (uint64_t)timeout > *due - now)
+        timeout = *due - now;
+
+    return timeout;
+}
+
+void *render_worker(void *arg)
+{
+    // render thread: lives as long as the process and draws whatever the
+    // event loop posts, so slow fetches never hold up the loop; between
+    // commands it keeps the neighbor screens pre-rendered
+
+    int screen = -1;
+    unsigned seen = 0;
+    int display_on = 0;
+    int timeout = -1;
+    uint64_t marquee_due = 0;
 
     while (1) {
-        if (exit_thread)
-            break;
+        uint64_t stamp;
+        int cmd;
 
-        usleep(250000);
-        current_time = time(NULL);
+        // a dark display needs nothing, so only a command wakes it
+        wait_for_command(display_on ? timeout : -1);
 
-        if (current_time > display_off_time) {
-            // set display off and exit
-            oled_turn_on_off(0);
+        if (atomic_load(&exit_thread))
             break;
-        } else if (current_time > display_refresh_time) {
-            // set display on
-            oled_turn_on_off(1);
-            // draw oled screen
-            switch (*cmd_index) {
-            case 0:
-                oled_clear_buffer();
-                oled_print(get_command_output("date +%R | awk '{printf \"%15s\", $1}'"), LINE1);
-                oled_print("  _  _", LINE1);
-                oled_print(" | \\| |___ ___", LINE2);
-                oled_print(" | .` / -_) _ \\", LINE3);
-                oled_print(" |_|\\_\\___\\___/", LINE4);
-                oled_redraw();
-                display_refresh_time = current_time + DISPLAY_OFF_TIMEOUT;
-                break;
-            case 1:{
-                char *views_raw, *subs_raw, *videos_raw;
-                char views_fmt[17], subs_fmt[17], videos_fmt[17]; // 16 chars + '\0'
-
-                get_channel_statistics(&views_raw, &subs_raw, &videos_raw);
-
-                format_number_str(views_raw, views_fmt, sizeof(views_fmt));
-                format_number_str(subs_raw, subs_fmt, sizeof(subs_fmt));
-                format_number_str(videos_raw, videos_fmt, sizeof(videos_fmt));
-
-                oled_clear_buffer();
-                oled_print("Your (>)YT stats", LINE1);
-                print_stat_line("Views:", views_fmt, LINE2);
-                print_stat_line("Subs:",  subs_fmt,  LINE3);
-                print_stat_line("Videos:", videos_fmt, LINE4);
-                oled_redraw();
-
-                display_refresh_time = current_time + DISPLAY_OFF_TIMEOUT;
-                break;
-            }
-            case 2: {
-                char line1[COMMAND_OUTPUT_BUFFER_LEN], line2[COMMAND_OUTPUT_BUFFER_LEN];
-                char line3[COMMAND_OUTPUT_BUFFER_LEN], line4[COMMAND_OUTPUT_BUFFER_LEN];
-
-                get_ip(line1, sizeof(line1));               // e.g. "IP:192.168.1.208"
-                get_disk_usage(line2, sizeof(line2));       // e.g. "/:    1.2/14.9GB"
-                get_mem_usage(line3, sizeof(line3));        // e.g. "RAM:   103/481MB"
-                get_temp_and_load(line4, sizeof(line4));    // e.g. "CPU: 24.1% 23.7C"
-
-                oled_clear_buffer();
-                oled_print(line1, LINE1);
-                oled_print(line2, LINE2);
-                oled_print(line3, LINE3);
-                oled_print(line4, LINE4);
-                oled_redraw();
-
-                display_refresh_time = current_time + 2;
-                break;
-            }
-            case 3:
-                oled_clear_buffer();
-                oled_print("   Power off?   ", LINE1);
-                oled_print("    -> NO       ", LINE2);
-                oled_print("       YES      ", LINE3);
-                oled_print("   F3: toggle   ", LINE4);
-                oled_redraw();
-
-                display_refresh_time = current_time + DISPLAY_OFF_TIMEOUT;
-                break;
-            case 4:
-                oled_clear_buffer();
-                oled_print("   Power off?   ", LINE1);
-                oled_print("       NO       ", LINE2);
-                oled_print("    -> YES      ", LINE3);
-                oled_print("   F1: confirm  ", LINE4);
-                oled_redraw();
-                display_refresh_time = current_time + DISPLAY_OFF_TIMEOUT;
+
+        if (take_screen(&seen, &cmd, &stamp)) {
+            if (cmd == SCREEN_OFF) {
+                if (display_on)
+                    oled_turn_on_off(0);
+                display_on = 0;
+                continue;
             }
+
+            if (!display_on)
+                oled_turn_on_off(1);
+            display_on = 1;
+
+            // the visible screen posted again is a refresh
+            show(cmd, stamp, cmd == screen);
+            screen = cmd;
         }
+
+        if (display_on)
+            timeout = prerender(screen, seen);
+
+        // the system screen scrolls a long IP address on its own clock
+        if (display_on && screen == 2 && marquee_scrolls(&ip_marquee))
+            timeout = step_marquee(&marquee_due, timeout);
     }
     return NULL;
 }
 
-int monitor_gpio(char *dev, int *lines, int num_lines, struct gpio_v2_line_config *config)
+static int arm_timer(int fd, int first, int interval)
 {
-    int cmd_index = 0;
-    int key1_cmd_index = 1;
-    int key2_cmd_index = 2;
-    int key3_cmd_index = 3;
-    pthread_t draw_thread;
-    int fd;
-    int rc;
+    // (re)arm a timerfd in seconds, first = 0 disarms it
+
+    struct itimerspec its = { { interval, 0 }, { first, 0 } };
+
+    return timerfd_settime(fd, 0, &its, NULL);
+}
+
+static void show_screen(int screen, uint64_t stamp, int refresh_fd, int off_fd)
+{
+    // switch screens: draw now, redraw at the screen's own interval and
+    // turn the display off once no key was pressed for a while
+
+    int interval = screens[screen].refresh;
+
+    post_screen(screen, stamp);
+    arm_timer(refresh_fd, interval, interval);
+    arm_timer(off_fd, DISPLAY_OFF_TIMEOUT, 0);
+}
+
+static int add_watch(int epfd, int fd)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static int arm_deadline(int fd, uint64_t ns)
+{
+    // arm a timerfd at an absolute CLOCK_MONOTONIC time, 0 disarms it
+
+    struct itimerspec its = { { 0, 0 }, { ns / 1000000000, ns % 1000000000 } };
 
-    rc = pthread_create(&draw_thread, NULL, draw_screen, &cmd_index);
-    if (rc != 0)
+    return timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int key_index(int offset)
+{
+    switch (offset) {
+    case LINE1_OFFSET:
+        return 0;
+    case LINE2_OFFSET:
+        return 1;
+    case LINE3_OFFSET:
+        return 2;
+    }
+    return -1;
+}
+
+static void apply_gesture(int gesture, int key, int *cmd_index)
+{
+    // a press moves through the menu, a long press goes back to the splash
+    // screen; a double press has no action of its own, it is counted (see
+    // print_stats) and is otherwise its second press, so two quick presses
+    // are two steps
+
+    switch (gesture) {
+    case KEY_DOUBLE:
+        key_doubles++;
+        // fall through
+    case KEY_PRESS:
+        *cmd_index = menu[*cmd_index][key];
+        break;
+    case KEY_LONG:
+        *cmd_index = 0;
+        break;
+    }
+}
+
+static int handle_keys(int fd, int long_fd, int *cmd_index, uint64_t *stamp)
+{
+    // drain the pending edge events and move through the menu
+    //
+    // stamp is set to the time of the last gesture, or 0 when there was
+    // none; a gap in the event sequence forgets which keys are held, a
+    // release may be among the lost events
+
+    struct gpio_v2_line_event event;
+    unsigned long dropped = key_events.dropped;
+
+    *stamp = 0;
+
+    if (gpio_read_events(fd, &key_events) < 0)
         return EXIT_FAILURE;
 
-    rc = gpio_request_line(dev, lines, num_lines, config, &fd);
-    if (rc == EXIT_SUCCESS)
-        while (1) {
-            struct gpio_v2_line_event event;
+    if (key_events.dropped != dropped)
+        keys_reset(&keys);
 
-            rc = read(fd, &event, sizeof(event));
-            if (rc == -1) {
-                if (errno == -EAGAIN) {
-                    // nothing available
-                    continue;
-                }
-                else {
-                    // failed to read event
-                    rc = EXIT_FAILURE;
-                    break;
-                }
-            }
+    while (*cmd_index != SHUTDOWN && gpio_next_event(&key_events, &event)) {
+        int key = key_index(event.offset);
+        int pressed = event.id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+        int gesture;
 
-            if (rc != sizeof(event)) {
-                // reading event failed
-                rc = EXIT_FAILURE;
-                break;
-            }
+        if (key < 0)
+            return EXIT_FAILURE;
 
-            switch (event.offset) {
-            case LINE1_OFFSET:
-                cmd_index = key1_cmd_index;
-                break;
-            case LINE2_OFFSET:
-                cmd_index = key2_cmd_index;
-                break;
-            case LINE3_OFFSET:
-                cmd_index = key3_cmd_index;
-                break;
-            default:
-                rc = EXIT_FAILURE;
-                goto exit_loop;
-            }
+        gesture = keys_edge(&keys, key, pressed, event.timestamp_ns);
+        if (gesture != KEY_NONE) {
+            apply_gesture(gesture, key, cmd_index);
+            *stamp = event.timestamp_ns;
+        }
+    }
+
+    arm_deadline(long_fd, keys_deadline(&keys));
 
-            // starting and terminating the screen threads
-            // we always need exactly 1 screen thread!
-            exit_thread = 1;
-            rc = pthread_join(draw_thread, NULL);
-            if (rc == 0) {
-                exit_thread = 0;
-                rc = pthread_create(&draw_thread, NULL, draw_screen, &cmd_index);
-                if (rc != 0) {
+    return EXIT_SUCCESS;
+}
+
+static int handle_long_press(int long_fd, int *cmd_index, uint64_t *stamp)
+{
+    // a key still held when its long-press deadline passed
+
+    struct timespec ts;
+    uint64_t expirations, now;
+    int key;
+
+    *stamp = 0;
+
+    if (read(long_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return EXIT_SUCCESS;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    if (keys_expire(&keys, now, &key) == KEY_LONG) {
+        apply_gesture(KEY_LONG, key, cmd_index);
+        *stamp = now;
+    }
+    arm_deadline(long_fd, keys_deadline(&keys));
+
+    return EXIT_SUCCESS;
+}
+
+int event_loop(int gpio_fd, int sig_fd)
+{
+    // single event loop: fn keys, refresh and display-off timers, signals
+    //
+    // nothing polls, epoll_wait() sleeps until the next key, signal or
+    // timer deadline, and with the display off no timer is armed at all
+
+    int cmd_index = 0;
+    int refresh_fd, off_fd, long_fd, epfd;
+    int ip_fd = -1, cmd_fd = -1;
+    int display_on = 1;
+    int running = 1;
+    int rc = EXIT_SUCCESS;
+
+    keys_init(&keys, LINES_COUNT, LONG_PRESS_NS, DOUBLE_PRESS_NS);
+
+    refresh_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    off_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    long_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (refresh_fd == -1 || off_fd == -1 || long_fd == -1 || epfd == -1 ||
+        add_watch(epfd, gpio_fd) || add_watch(epfd, sig_fd) ||
+        add_watch(epfd, refresh_fd) || add_watch(epfd, off_fd) ||
+        add_watch(epfd, long_fd)) {
+        rc = EXIT_FAILURE;
+        running = 0;
+    } else {
+        // addresses come from netlink events, get_ip() falls back to
+        // `hostname -I` if the socket cannot be had
+        ip_fd = ipaddr_open();
+        if (ip_fd != -1 && add_watch(epfd, ip_fd)) {
+            ipaddr_close();
+            ip_fd = -1;
+        }
+
+        // command-backed fields are spawned and read from here
+        cmd_fd = cmd_open();
+        if (cmd_fd != -1 && add_watch(epfd, cmd_fd)) {
+            cmd_close();
+            cmd_fd = -1;
+        }
+
+        show_screen(cmd_index, 0, refresh_fd, off_fd);
+    }
+
+    while (running) {
+        struct epoll_event events[7];
+        int n;
+
+        n = epoll_wait(epfd, events, 7, -1);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            rc = EXIT_FAILURE;
+            break;
+        }
+        loop_wakeups++;
+
+        for (int i = 0; i < n && running; i++) {
+            int fd = events[i].data.fd;
+            uint64_t expirations;
+
+            if (fd == gpio_fd || fd == long_fd) {
+                uint64_t stamp;
+
+                if (fd == gpio_fd)
+                    rc = handle_keys(gpio_fd, long_fd, &cmd_index, &stamp);
+                else
+                    rc = handle_long_press(long_fd, &cmd_index, &stamp);
+
+                if (rc != EXIT_SUCCESS) {
                     rc = EXIT_FAILURE;
-                    goto exit_loop;
+                    running = 0;
+                } else if (cmd_index == SHUTDOWN) {
+                    system("shutdown now");
+                    running = 0;
+                } else if (stamp) {
+                    // the render thread picks the screen up right away
+                    show_screen(cmd_index, stamp, refresh_fd, off_fd);
+                    display_on = 1;
                 }
-            } else {
-                rc = EXIT_FAILURE;
-                goto exit_loop;
-            }
+            } else if (fd == refresh_fd) {
+                if (read(refresh_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+                    post_screen(cmd_index, 0);
+            } else if (fd == off_fd) {
+                if (read(off_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    arm_timer(refresh_fd, 0, 0);
+                    post_screen(SCREEN_OFF, 0);
+                    display_on = 0;
+                }
+            } else if (fd == ip_fd) {
+                // the stats screen picks changes up at its next refresh
+                if (ipaddr_read() < 0) {
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, ip_fd, NULL);
+                    ipaddr_close();
+                    ip_fd = -1;
+                }
+            } else if (fd == cmd_fd) {
+                // redraw only for output the visible screen shows, a
+                // repost of the YouTube screen would fetch it again
+                unsigned changed = cmd_dispatch();
+
+                if (display_on && (changed & screen_commands(cmd_index)))
+                    post_screen(cmd_index, 0);
+            } else if (fd == sig_fd) {
+                struct signalfd_siginfo si;
 
-            switch (cmd_index) {
-            case 0:
-                key1_cmd_index = 1;
-                key2_cmd_index = 2;
-                key3_cmd_index = 3;
-                break;
-            case 1:
-                key1_cmd_index = 0;
-                key2_cmd_index = 2;
-                key3_cmd_index = 3;
-                break;
-            case 2:
-                key1_cmd_index = 1;
-                key2_cmd_index = 0;
-                key3_cmd_index = 3;
-                break;
-            case 3:
-                key1_cmd_index = 1;
-                key2_cmd_index = 2;
-                key3_cmd_index = 4;
-                break;
-            case 4:
-                key1_cmd_index = 99;
-                key2_cmd_index = 4;
-                key3_cmd_index = 3;
-                break;
-            case 99:
-                system("shutdown now");
-                goto exit_loop;
-            default:
-                rc = EXIT_FAILURE;
-                goto exit_loop;
+                if (read(sig_fd, &si, sizeof(si)) != sizeof(si))
+                    continue;
+                if (si.ssi_signo == SIGUSR1)
+                    print_stats();
+                else
+                    running = 0;
             }
         }
- exit_loop:
+    }
 
-    rc |= gpio_release_line(fd);
+    if (cmd_fd != -1)
+        cmd_close();
+    if (ip_fd != -1)
+        ipaddr_close();
+    if (epfd != -1)
+        close(epfd);
+    if (long_fd != -1)
+        close(long_fd);
+    if (off_fd != -1)
+        close(off_fd);
+    if (refresh_fd != -1)
+        close(refresh_fd);
+
+    return rc;
+}
+
+int monitor_gpio(char *dev, int *lines, int num_lines, struct gpio_v2_line_config *config, int sig_fd)
+{
+    pthread_t render_thread;
+    int fd;
+    int rc;
+
+    render_wake = eventfd(0, EFD_CLOEXEC);
+    if (render_wake == -1)
+        return EXIT_FAILURE;
+
+    rc = pthread_create(&render_thread, NULL, render_worker, NULL);
+    if (rc != 0) {
+        close(render_wake);
+        return EXIT_FAILURE;
+    }
+
+    rc = gpio_request_events(dev, lines, num_lines, config, KEY_EVENT_BUFFER, &fd);
+    if (rc == EXIT_SUCCESS) {
+        // the loop only reads when epoll reported an event
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        rc = event_loop(fd, sig_fd);
+        rc |= gpio_release_line(fd);
+    }
+
+    atomic_store(&exit_thread, 1);
+    post_screen(SCREEN_OFF, 0);
+    pthread_join(render_thread, NULL);
+    close(render_wake);
 
     return rc;
 }
@@ -283,15 +868,32 @@ int monitor_gpio(char *dev, int *lines, int num_lines, struct gpio_v2_line_confi
 int main(int argc, char **argv)
 {
     struct gpio_v2_line_config config;
+    sigset_t mask;
     int lines[LINES_COUNT];
     int attr, i;
+    int sig_fd;
     int rc;
 
+    // signals are read from the event loop: SIGUSR1 dumps bus and flush
+    // statistics to stderr, SIGINT/SIGTERM turn the display off and exit;
+    // blocked before any thread starts so every thread inherits the mask
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sig_fd == -1)
+        exit(EXIT_FAILURE);
+
     oled_init();
     oled_redraw();
+    oled_start_flush_thread();
+    marquee_init(&ip_marquee, &font_8x16, 3 * 8, 0, OLED_WIDTH - 3 * 8);
+    clock_cmd = cmd_register(CLOCK_COMMAND, CLOCK_TTL_MS, COMMAND_TIMEOUT_MS);
 
     memset(&config, 0, sizeof(config));
-    config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING;
+    config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
     lines[0] = LINE1_OFFSET;
     lines[1] = LINE2_OFFSET;
     lines[2] = LINE3_OFFSET;
@@ -304,7 +906,8 @@ int main(int argc, char **argv)
     config.attrs[attr].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
     config.attrs[attr].attr.debounce_period_us = DEBOUNCE_PERIOD_US;
 
-    rc = monitor_gpio(NPINEO_GPIO_DEV, lines, LINES_COUNT, &config);
+    rc = monitor_gpio(NPINEO_GPIO_DEV, lines, LINES_COUNT, &config, sig_fd);
+    oled_stop_flush_thread();
     rc |= oled_turn_on_off(0);
 
     exit(rc);
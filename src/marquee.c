@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oled.h"
+
+#include "marquee.h"
+
+void marquee_init(struct marquee *m, struct font *f, int x, int y, int width)
+{
+    uint64_t cell;
+
+    memset(m, 0, sizeof(*m));
+    m->font = f;
+    m->x = x;
+    m->y = y;
+    m->width = width;
+    m->stride = font_stride(f, y & 7);
+
+    cell = ((1ULL << f->height) - 1) << (y & 7);
+    for (int k = 0; k < m->stride; k++)
+        m->mask[k] = cell >> (k << 3);
+}
+
+void marquee_free(struct marquee *m)
+{
+    free(m->strip);
+    m->strip = NULL;
+}
+
+int marquee_set_text(struct marquee *m, const char *text)
+{
+    // rebuild the strip, only if the text is not the one it holds; when
+    // the strip cannot grow, the old text and strip stay as they were
+
+    char new_text[MARQUEE_TEXT_MAX];
+    int text_width, period, columns;
+    unsigned char *strip;
+
+    if (m->strip && !strncmp(m->text, text, sizeof(m->text) - 1))
+        return 0;
+
+    snprintf(new_text, sizeof(new_text), "%s", text);
+    text_width = font_text_width(m->font, new_text);
+
+    period = (text_width > m->width) ? text_width + MARQUEE_GAP : 0;
+    columns = period + m->width;
+
+    strip = realloc(m->strip, (size_t)columns * m->stride);
+    if (!strip)
+        return 0;
+
+    m->strip = strip;
+    m->period = period;
+    memcpy(m->text, new_text, sizeof(m->text));
+    memset(strip, 0, (size_t)columns * m->stride);
+    font_rasterize(m->font, m->y & 7, m->text, strip, m->period ? text_width : m->width);
+
+    // the window wrapping around reads the start again
+    if (m->period)
+        memcpy(strip + m->period * m->stride, strip, (size_t)m->width * m->stride);
+
+    m->offset = 0;
+    m->rasterized++;
+
+    return 1;
+}
+
+void marquee_draw(struct marquee *m)
+{
+    if (!m->strip)
+        return;
+
+    oled_blit_columns(m->x, m->y >> 3, m->width, m->stride, m->strip + m->offset * m->stride, m->mask);
+}
+
+void marquee_step(struct marquee *m, int columns)
+{
+    if (!m->period)
+        return;
+
+    m->offset = (m->offset + columns) % m->period;
+    m->steps++;
+    marquee_draw(m);
+}
+
+int marquee_scrolls(const struct marquee *m)
+{
+    return m->period > 0;
+}
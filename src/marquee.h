@@ -0,0 +1,41 @@
+#pragma once
+
+#include "font.h"
+
+// marquee: text wider than its window, scrolled through it
+//
+// the text is rasterized once into an off-screen strip (text, a gap and
+// a copy of the first window, so every window is contiguous); a step
+// only copies a window of the strip into the buffer, nothing is drawn
+// again until the text changes
+
+#define MARQUEE_TEXT_MAX    64
+#define MARQUEE_GAP         24          // blank columns before the text repeats
+
+struct marquee {
+    struct font *font;
+    int x, y, width;                    // window on the panel (pixels)
+    char text[MARQUEE_TEXT_MAX];
+
+    unsigned char *strip;               // column-major, already shifted to y
+    int stride;                         // bytes per strip column
+    int period;                         // text + gap columns, 0 = text fits
+    int offset;                         // strip column at the left of the window
+    unsigned char mask[5];              // window rows on each page
+
+    unsigned long rasterized;           // strips built
+    unsigned long steps;                // windows copied
+};
+
+void marquee_init(struct marquee *m, struct font *f, int x, int y, int width);
+void marquee_free(struct marquee *m);
+
+// returns 1 when the text changed (and the strip was rebuilt)
+int marquee_set_text(struct marquee *m, const char *text);
+
+// copy the current window into the buffer / advance by columns first
+void marquee_draw(struct marquee *m);
+void marquee_step(struct marquee *m, int columns);
+
+// the text is wider than the window, so it needs stepping
+int marquee_scrolls(const struct marquee *m);
@@ -1,20 +1,35 @@
+#define _GNU_SOURCE                     // sem_clockwait
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "font.h"
 #include "i2c.h"
+#include "raster.h"
 
 #include "oled.h"
 
 // constants
 #define OLED_I2C_DEV	"i2c-0"
 #define OLED_I2C_ADDR	0x3C
+#define OLED_MAX_BUSES  4               // adapters flushed in parallel
+#define OLED_BUS_PANELS 4               // panels queued on one adapter
 #define COMMAND		    0x80
+#define COMMAND_STREAM	0x00
 #define DATA		    0x40
 
-#define OLED_WIDTH      128
-#define OLED_HEIGHT      64
+// a partial flush costs a command transaction plus a data transaction,
+// merged windows and full flushes are preferred once they are cheaper
+#define WINDOW_OVERHEAD 10
+#define FULL_FLUSH_THRESHOLD    (OLED_BUFFER_SIZE * 3 / 4)
 
-//      buffer(index) <-> display
+//      buffer(index) <-> display (128x64, see panel.h for the others)
 // |   0|   1|   2|........| 126| 127|
 // | 128|....                   | 255|
 // | 256|....                   |    |
@@ -50,26 +65,411 @@
 //                                (8*row) | | | | | | | | | |
 //                                  \/    | | | | | | | | | |
 //                                        | | | | | | | | | |
-static unsigned char buffer[1024];
+//
+// frame[0] is headroom for the DATA control byte, so the framebuffer can
+// be pushed to the bus in place, without a per-frame copy or allocation
+
+// dirty tracking
+//
+// every drawing call widens the column span [lo, hi] of the pages it
+// touches, the flush narrows the spans down to the bytes that really
+// differ from shadow (a copy of what GDDRAM holds) and sends only those
+// windows
+struct dirty {
+    int lo[OLED_PAGES];
+    int hi[OLED_PAGES];
+};
+
+// hardware scroll and start line state
+//
+// the renderer describes the wanted state, the flush reconciles the
+// controller with it; being a state rather than a command it survives
+// frame coalescing
+struct scroll {
+    int active;
+    int cmd;                            // 0x26/0x27 horizontal, 0x29/0x2A diagonal
+    int page_start, page_end;
+    int interval;                       // SSD1306 frame interval code 0..7
+    int vertical;                       // rows per step (diagonal only)
+    int start_line;                     // 0x40 | n, -1 = unknown
+};
+
+// double buffering
+//
+// the renderer draws into slots[draw_idx] while the flush thread sends
+// slots[flush_idx]; publishing a frame atomically exchanges the draw slot
+// with the ready slot, so a frame that was never picked up is recycled
+// (coalesced) and the flush thread always gets the most recent one
+struct frame_slot {
+    unsigned char frame[1 + OLED_BUFFER_SIZE];  // DATA headroom + pixels
+    struct dirty dirty;                 // changes since the last frame sent
+    struct scroll scroll;               // hardware scroll state to apply
+    uint64_t stamp;                     // oldest input event shown, 0 = none
+};
+
+#define FRESH   4                       // ready slot not consumed yet
+
+// temporal-dithering grayscale
+//
+// a 2-bit gray frame is two bit-planes; the bus worker shows the MSB
+// plane for two subframes and the LSB plane for one, so a pixel is lit
+// for level/3 of the time; planes are published like frames, through a
+// slot exchange of their own
+struct gray_slot {
+    unsigned char plane[2][1 + OLED_BUFFER_SIZE];  // LSB, MSB with DATA headroom
+};
+
+static const int gray_cycle[] = { 1, 1, 0 };    // plane shown per subframe
+#define GRAY_SUBFRAMES  (int)(sizeof(gray_cycle) / sizeof(gray_cycle[0]))
+
+// a panel: its bus session, frame slots and flush state
+struct oled {
+    char dev[16];                       // adapter, panels on one share a worker
+    int addr;
+
+    // bus session kept open for the life of the panel (see oled_init)
+    struct i2c_session session;
+    struct oled_transport i2c_transport;
+    struct oled_transport *transport;   // every transaction goes through it
+    struct flush_bus *queue;            // bus worker flushing it, NULL = none
+
+    struct frame_slot slots[3];
+    atomic_int ready;
+
+    // owned by the renderer
+    int draw_idx;
+    struct dirty pending;               // changes since the last publish
+    struct dirty unconsumed;            // changes since the last frame taken
+    struct scroll scroll_want;
+    uint64_t stamp_pending;             // input event the next frame answers
+    uint64_t stamp_published;           // tag of the last published frame
+    unsigned long generation;
+    atomic_ulong frames;                // flush_stats.frames and .coalesced,
+    atomic_ulong coalesced;             // read without the bus lock
+
+    // owned by whoever flushes (the bus worker once it is running)
+    int flush_idx;
+    unsigned char shadow[OLED_BUFFER_SIZE];
+    int shadow_valid;                   // GDDRAM content known
+    int window_full;                    // address window is the whole panel
+    struct scroll scroll_hw;            // what the controller is doing
+
+    // scratch for partial windows, which are not contiguous in buffer
+    unsigned char window[1 + OLED_BUFFER_SIZE];
+
+    // grayscale mode, gray_period is changed with the bus lock held
+    struct gray_slot gray_slots[3];
+    atomic_int gray_ready;
+    int gray_draw_idx;                  // owned by the renderer
+    uint64_t gray_period;               // ns per subframe, 0 = mode off
+    int gray_show_idx;                  // owned by the worker from here on
+    int gray_shown;                     // a gray frame was taken
+    int gray_tick;                      // subframe of the cycle
+    int gray_plane;                     // plane in GDDRAM, -1 = none
+    uint64_t gray_next;                 // deadline of the next subframe
+    struct dirty gray_diff;             // spans where the two planes differ
+
+    struct oled_flush_stats flush_stats;
+};
+
+static int i2c_transport_write(void *ctx, unsigned char *buf, int count)
+{
+    return i2c_session_write(ctx, buf, count);
+}
+
+// the panel every call acts on unless oled_select() picked another one,
+// /dev/i2c-0 at 0x3C on the NanoHat; owned by the drawing thread (see
+// oled.h), like target, buffer and the clip rectangle
+static struct oled panel0 = {
+    .dev = OLED_I2C_DEV,
+    .addr = OLED_I2C_ADDR,
+    .session = { .fd = -1 },
+    .i2c_transport = { i2c_transport_write, &panel0.session },
+    .transport = &panel0.i2c_transport,
+    .slots = { { .frame = { DATA } }, { .frame = { DATA } }, { .frame = { DATA } } },
+    .ready = 2,
+    .flush_idx = 1,
+    .gray_ready = 2,
+    .gray_show_idx = 1,
+};
+static struct oled *cur = &panel0;
+
+static int bus_write(struct oled *d, unsigned char *buf, int count)
+{
+    return d->transport->write(d->transport->ctx, buf, count);
+}
+
+// bus workers
+//
+// one flush thread per I2C adapter, so panels on different adapters are
+// sent in parallel; panels sharing an adapter sit in its queue and are
+// served in rounds, at most one frame each per round and starting with
+// the next panel every round, so a panel redrawn all the time cannot
+// starve the others
+struct flush_bus {
+    char dev[16];
+    pthread_t thread;
+    sem_t sem;                          // posted once per published frame
+    atomic_int running;
+    pthread_mutex_t lock;               // held for a round and to join or leave
+    struct oled *panels[OLED_BUS_PANELS];
+    int count;
+    int next;                           // panel served first in the next round
+};
+
+static struct flush_bus buses[OLED_MAX_BUSES];
+static pthread_mutex_t buses_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void dirty_mark(struct dirty *d, int first, int last)
+{
+    // mark buffer bytes [first, last] as modified
+
+    if (first < 0)
+        first = 0;
+    if (last > OLED_BUFFER_SIZE - 1)
+        last = OLED_BUFFER_SIZE - 1;
+
+    for (int page = first / OLED_WIDTH; page <= last / OLED_WIDTH; page++) {
+        int lo = (page == first / OLED_WIDTH) ? first % OLED_WIDTH : 0;
+        int hi = (page == last / OLED_WIDTH) ? last % OLED_WIDTH : OLED_WIDTH - 1;
+
+        if (lo < d->lo[page])
+            d->lo[page] = lo;
+        if (hi > d->hi[page])
+            d->hi[page] = hi;
+    }
+}
+
+static void dirty_merge(struct dirty *d, const struct dirty *src)
+{
+    for (int page = 0; page < OLED_PAGES; page++) {
+        if (src->lo[page] < d->lo[page])
+            d->lo[page] = src->lo[page];
+        if (src->hi[page] > d->hi[page])
+            d->hi[page] = src->hi[page];
+    }
+}
+
+static void dirty_clear(struct dirty *d)
+{
+    for (int page = 0; page < OLED_PAGES; page++) {
+        d->lo[page] = OLED_WIDTH;
+        d->hi[page] = -1;
+    }
+}
+
+// off-screen canvases
+//
+// drawing calls go to the display buffer of the selected panel or, once
+// selected, to one of these; a canvas is brought on screen with
+// oled_present_canvas(), so canvases are shared by all panels
+static unsigned char canvases[OLED_CANVAS_MAX][OLED_BUFFER_SIZE];
+static int target = OLED_DISPLAY;
+static unsigned char *buffer = panel0.slots[0].frame + 1;
+
+// generation of every draw target (panels and canvases), stamped from
+// one clock so a value never matches another target's
+static unsigned long generation_clock = 0;
+static unsigned long canvas_generations[OLED_CANVAS_MAX];
+
+static void mark_dirty(int first, int last)
+{
+    if (target == OLED_DISPLAY) {
+        dirty_mark(&cur->pending, first, last);
+        cur->generation = ++generation_clock;
+    } else {
+        canvas_generations[target] = ++generation_clock;
+    }
+}
+
+unsigned long oled_get_generation()
+{
+    return target == OLED_DISPLAY ? cur->generation : canvas_generations[target];
+}
+
+struct oled *oled_open(const char *dev, int addr)
+{
+    // another panel, at addr on /dev/<dev>
+    //
+    // nothing is sent yet: select the panel, then oled_init() opens the
+    // adapter and oled_start_flush_thread() hands it to the bus worker
+
+    struct oled *d = calloc(1, sizeof(*d));
+
+    if (!d)
+        return NULL;
+
+    snprintf(d->dev, sizeof(d->dev), "%s", dev);
+    d->addr = addr;
+    d->session.fd = -1;
+    d->i2c_transport.write = i2c_transport_write;
+    d->i2c_transport.ctx = &d->session;
+    d->transport = &d->i2c_transport;
+    for (int i = 0; i < 3; i++)
+        d->slots[i].frame[0] = DATA;
+    d->flush_idx = 1;
+    atomic_init(&d->ready, 2);
+    d->gray_show_idx = 1;
+    atomic_init(&d->gray_ready, 2);
+
+    return d;
+}
+
+void oled_close(struct oled *d)
+{
+    // take a panel from oled_open() off its bus and release it, the
+    // NanoHat panel is selected if d was
+
+    struct oled *prev;
+
+    if (!d || d == &panel0)
+        return;
+
+    prev = oled_select(d);
+    oled_stop_flush_thread();
+    oled_select(prev == d ? NULL : prev);
+
+    if (d->session.fd >= 0)
+        i2c_close(&d->session);
+    free(d);
+}
+
+struct oled *oled_select(struct oled *d)
+{
+    // direct every other oled_* call to a panel (NULL = the NanoHat
+    // panel), returns the panel selected so far
+
+    struct oled *prev = cur;
+
+    cur = d ? d : &panel0;
+    if (target == OLED_DISPLAY)
+        buffer = cur->slots[cur->draw_idx].frame + 1;
+
+    return prev;
+}
+
+int oled_select_canvas(int canvas)
+{
+    // direct the drawing calls to an off-screen canvas, or back to the
+    // display buffer with OLED_DISPLAY
+
+    if (canvas < OLED_DISPLAY || canvas >= OLED_CANVAS_MAX)
+        return EXIT_FAILURE;
+
+    target = canvas;
+    buffer = (canvas == OLED_DISPLAY) ? cur->slots[cur->draw_idx].frame + 1 : canvases[canvas];
+
+    return EXIT_SUCCESS;
+}
+
+int oled_present_canvas(int canvas)
+{
+    // copy a canvas into the display buffer
+    //
+    // only bytes that differ are copied and marked dirty, so presenting a
+    // canvas that is already on screen leaves the generation alone and
+    // the next flush sends just the changes
+
+    unsigned char *disp = cur->slots[cur->draw_idx].frame + 1;
+
+    if (canvas < 0 || canvas >= OLED_CANVAS_MAX || target != OLED_DISPLAY)
+        return EXIT_FAILURE;
+
+    for (int page = 0; page < OLED_PAGES; page++) {
+        int off = page * OLED_WIDTH;
+        int first, last;
+
+        if (!raster_diff(canvases[canvas] + off, disp + off, OLED_WIDTH, &first, &last))
+            continue;
+
+        memcpy(disp + off + first, canvases[canvas] + off + first, last - first + 1);
+        mark_dirty(off + first, off + last);
+    }
+
+    return EXIT_SUCCESS;
+}
 
 unsigned char *oled_get_buffer()
 {
+    // the caller may write anywhere, so the whole frame becomes dirty
+    //
+    // returns the selected draw target; for the display the pointer is
+    // only valid until the next oled_redraw(), which switches to another
+    // slot once the flush thread is running
+
+    mark_dirty(0, OLED_BUFFER_SIZE - 1);
+
     return buffer;
 }
 
+void oled_get_flush_stats(struct oled_flush_stats *stats)
+{
+    // the bus worker updates the counters within a round, with its lock
+    // held; the renderer counts frames in atomics of its own, so any
+    // thread may ask while a worker runs (without one, only the renderer)
+
+    if (cur->queue)
+        pthread_mutex_lock(&cur->queue->lock);
+    *stats = cur->flush_stats;
+    if (cur->queue)
+        pthread_mutex_unlock(&cur->queue->lock);
+    stats->frames = atomic_load_explicit(&cur->frames, memory_order_relaxed);
+    stats->coalesced = atomic_load_explicit(&cur->coalesced, memory_order_relaxed);
+}
+
+void oled_set_frame_stamp(uint64_t ns)
+{
+    // tag the next published frame with the CLOCK_MONOTONIC time of the
+    // input event it answers, 0 cancels a tag no frame picked up
+
+    cur->stamp_pending = ns;
+}
+
+static uint64_t monotonic_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void record_latency(struct oled *d, uint64_t stamp)
+{
+    // event-to-flush latency of a frame that just reached the controller
+
+    uint64_t now = monotonic_ns();
+    uint64_t lat = now > stamp ? now - stamp : 0;
+
+    d->flush_stats.stamped++;
+    d->flush_stats.latency_last_ns = lat;
+    d->flush_stats.latency_total_ns += lat;
+    if (lat > d->flush_stats.latency_max_ns)
+        d->flush_stats.latency_max_ns = lat;
+}
+
+void oled_set_transport(struct oled_transport *t)
+{
+    // route the display traffic through another transport (NULL = I2C),
+    // call before oled_init()
+
+    cur->transport = t ? t : &cur->i2c_transport;
+}
+
 int oled_init()
 {
-    // initialize SSD1306
+    // initialize the controller (SSD1306 or SH1106, see panel.h)
 
+    struct oled *d = cur;
     unsigned char init[] = {
-        0xAE,		    // display OFF
+        COMMAND, 0xAE,	// display OFF
         COMMAND, 0x40,	// set display start line
         COMMAND, 0x81,	// contrast control
         COMMAND, 0xCF,	// 128
         COMMAND, 0xA1,	// set segment remap
         COMMAND, 0xA6,	// set display normal (not inverse)
         COMMAND, 0xA8,	// set multiplex ratio
-        COMMAND, 0x3F,	// set duty 1/64
+        COMMAND, OLED_HEIGHT - 1,	// set duty 1/64 (1/32)
         COMMAND, 0xC8,	// set com scan direction
         COMMAND, 0xD3,	// set display offset
         COMMAND, 0x00,
@@ -78,17 +478,41 @@ int oled_init()
         COMMAND, 0xD9,	// set pre-charge period
         COMMAND, 0xF1,
         COMMAND, 0xDA,	// set com pins
-        COMMAND, 0x12,
+        COMMAND, OLED_COM_PINS,
+#if OLED_PAGE_MODE
+        COMMAND, 0xDB,	// set vcomh
+        COMMAND, 0x40,
+        COMMAND, 0xAD,	// set DC-DC on
+        COMMAND, 0x8B,
+        COMMAND, 0x32,	// pump voltage 8.0 V
+#else
         COMMAND, 0xDB,	// set vcomh
         COMMAND, 0x30,
         COMMAND, 0x8D,	// set charge pump on
         COMMAND, 0x14,
         COMMAND, 0x20,	// set memory addressing mode
         COMMAND, 0x00,	// horizontal addressing mode
+        COMMAND, 0x2E,	// deactivate scroll (left over by a previous run)
+#endif
         COMMAND, 0xAF	// display ON
     };
 
-    return i2c_write_nreg(OLED_I2C_DEV, OLED_I2C_ADDR, COMMAND, init, 47);
+    // open the bus once, every later transfer reuses the session
+    if (d->transport == &d->i2c_transport && d->session.fd < 0
+        && i2c_open(d->dev, d->addr, &d->session) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    // GDDRAM content and address window are unknown after (re)init,
+    // must not be called while the panel is on its bus worker
+    d->shadow_valid = 0;
+    d->window_full = 0;
+    memset(&d->scroll_hw, 0, sizeof(d->scroll_hw));
+    memset(&d->scroll_want, 0, sizeof(d->scroll_want));
+    dirty_clear(&d->pending);
+    dirty_mark(&d->pending, 0, OLED_BUFFER_SIZE - 1);
+    d->generation = ++generation_clock;
+
+    return bus_write(d, init, sizeof(init));
 }
 
 int oled_turn_on_off(int state)
@@ -97,31 +521,731 @@ int oled_turn_on_off(int state)
     //      1 = ON
     //      0 = OFF
 
-    if (state == 1)
-        return i2c_write_reg(OLED_I2C_DEV, OLED_I2C_ADDR, COMMAND, 0xAF);
-    else
-        return i2c_write_reg(OLED_I2C_DEV, OLED_I2C_ADDR, COMMAND, 0xAE);
+    unsigned char cmd[] = { COMMAND, state == 1 ? 0xAF : 0xAE };
+
+    return bus_write(cur, cmd, sizeof(cmd));
+}
+
+#if OLED_PAGE_MODE
+static int set_page(struct oled *d, int page, int c0)
+{
+    // move the RAM pointer to a column of a page (page addressing mode)
+
+    int col = c0 + OLED_COLUMN_OFFSET;
+    unsigned char cmd[] = {
+        COMMAND_STREAM,
+        0xB0 | page,            // page
+        col & 0x0F,             // column, low nibble
+        0x10 | (col >> 4)       // column, high nibble
+    };
+
+    d->flush_stats.bytes_sent += sizeof(cmd);
+
+    return bus_write(d, cmd, sizeof(cmd));
+}
+
+static int flush_window(struct oled *d, const unsigned char *pix, int c0, int c1, int p0, int p1)
+{
+    // push a rectangle of pixels to GDDRAM and record it in shadow
+    //
+    // the pointer does not move on to the next page, so every page is a
+    // command transaction plus a data transaction
+
+    int width = c1 - c0 + 1;
+
+    d->window[0] = DATA;
+    for (int page = p0; page <= p1; page++) {
+        const unsigned char *src = &pix[page * OLED_WIDTH + c0];
+
+        memcpy(&d->window[1], src, width);
+        if (set_page(d, page, c0) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        if (bus_write(d, d->window, 1 + width) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+
+        memcpy(&d->shadow[page * OLED_WIDTH + c0], src, width);
+        d->flush_stats.bytes_sent += 1 + width;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int flush_full(struct oled *d, unsigned char *frm)
+{
+    // push a whole frame to GDDRAM, one page at a time
+
+    int rc = flush_window(d, frm + 1, 0, OLED_WIDTH - 1, 0, OLED_PAGES - 1);
+
+    if (rc == EXIT_SUCCESS)
+        d->shadow_valid = 1;
+
+    d->flush_stats.full_flushes++;
+
+    return rc;
+}
+#else
+static int set_window(struct oled *d, int c0, int c1, int p0, int p1)
+{
+    // set the GDDRAM address window (horizontal addressing mode)
+
+    unsigned char cmd[] = {
+        COMMAND_STREAM,
+        0x21, c0, c1,   // column start/end
+        0x22, p0, p1    // page start/end
+    };
+    int rc;
+
+    d->flush_stats.bytes_sent += sizeof(cmd);
+
+    // the cached window is only what the controller acknowledged
+    rc = bus_write(d, cmd, sizeof(cmd));
+    d->window_full = rc == EXIT_SUCCESS
+        && c0 == 0 && c1 == OLED_WIDTH - 1 && p0 == 0 && p1 == OLED_PAGES - 1;
+
+    return rc;
+}
+
+static int flush_full(struct oled *d, unsigned char *frm)
+{
+    // push a whole frame to GDDRAM (control byte + frame in place)
+
+    int rc = EXIT_SUCCESS;
+
+    if (!d->window_full)
+        rc = set_window(d, 0, OLED_WIDTH - 1, 0, OLED_PAGES - 1);
+
+    if (rc == EXIT_SUCCESS)
+        rc = bus_write(d, frm, 1 + OLED_BUFFER_SIZE);
+
+    if (rc == EXIT_SUCCESS) {
+        memcpy(d->shadow, frm + 1, sizeof(d->shadow));
+        d->shadow_valid = 1;
+    } else {
+        // a frame cut short leaves the address pointer mid-window
+        d->window_full = 0;
+    }
+
+    d->flush_stats.full_flushes++;
+    d->flush_stats.bytes_sent += 1 + OLED_BUFFER_SIZE;
+
+    return rc;
+}
+
+static int flush_window(struct oled *d, const unsigned char *pix, int c0, int c1, int p0, int p1)
+{
+    // push a rectangle of pixels to GDDRAM and record it in shadow
+
+    int n = 1;
+    int width = c1 - c0 + 1;
+
+    d->window[0] = DATA;
+    for (int page = p0; page <= p1; page++) {
+        memcpy(&d->window[n], &pix[page * OLED_WIDTH + c0], width);
+        n += width;
+    }
+
+    if (set_window(d, c0, c1, p0, p1) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (bus_write(d, d->window, n) != EXIT_SUCCESS) {
+        d->window_full = 0;
+        return EXIT_FAILURE;
+    }
+
+    for (int page = p0; page <= p1; page++)
+        memcpy(&d->shadow[page * OLED_WIDTH + c0], &pix[page * OLED_WIDTH + c0], width);
+
+    d->flush_stats.bytes_sent += n;
+
+    return EXIT_SUCCESS;
+}
+#endif
+
+static int flush_pixels(struct oled *d, unsigned char *frm, int *lo, int *hi, int total)
+{
+    // send the narrowed spans as windows, or the whole frame once most
+    // of the screen changed
+
+    const unsigned char *pix = frm + 1;
+    int page = 0;
+    int rc = EXIT_SUCCESS;
+
+    if (!d->shadow_valid || total >= FULL_FLUSH_THRESHOLD) {
+        // the spans are consumed, GDDRAM must not be trusted after a failure
+        rc = flush_full(d, frm);
+        if (rc != EXIT_SUCCESS)
+            d->shadow_valid = 0;
+        return rc;
+    }
+
+    d->flush_stats.partial_flushes++;
+
+    while (page < OLED_PAGES && rc == EXIT_SUCCESS) {
+        if (lo[page] > hi[page]) {
+            page++;
+            continue;
+        }
+
+        // grow the window downwards while merging is cheaper (never in
+        // page addressing mode, where each page is addressed anyway)
+        int p0 = page, p1 = page;
+        int c0 = lo[page], c1 = hi[page];
+        int cost = (c1 - c0 + 1) + WINDOW_OVERHEAD;
+
+        while (!OLED_PAGE_MODE && p1 + 1 < OLED_PAGES && lo[p1 + 1] <= hi[p1 + 1]) {
+            int n0 = lo[p1 + 1] < c0 ? lo[p1 + 1] : c0;
+            int n1 = hi[p1 + 1] > c1 ? hi[p1 + 1] : c1;
+            int merged = (n1 - n0 + 1) * (p1 - p0 + 2) + WINDOW_OVERHEAD;
+            int split = cost + (hi[p1 + 1] - lo[p1 + 1] + 1) + WINDOW_OVERHEAD;
+
+            if (merged > split)
+                break;
+
+            c0 = n0;
+            c1 = n1;
+            cost = merged;
+            p1++;
+        }
+
+        rc = flush_window(d, pix, c0, c1, p0, p1);
+        page = p1 + 1;
+    }
+
+    // GDDRAM state is unknown after a failed partial update
+    if (rc != EXIT_SUCCESS)
+        d->shadow_valid = 0;
+
+    return rc;
+}
+
+static int scroll_same(const struct scroll *a, const struct scroll *b)
+{
+    if (!a->active || !b->active)
+        return a->active == b->active;
+
+    return a->cmd == b->cmd && a->page_start == b->page_start
+        && a->page_end == b->page_end && a->interval == b->interval
+        && a->vertical == b->vertical;
+}
+
+static int scroll_deactivate(struct oled *d, int *lo, int *hi, int *total)
+{
+    // stop the controller scrolling
+    //
+    // the scrolled pages were rotated in GDDRAM by an unknown number of
+    // steps, so they are rewritten from the frame by this flush; a
+    // diagonal scroll also moved the start line
+
+    unsigned char cmd[] = { COMMAND_STREAM, 0x2E };
+
+    d->flush_stats.bytes_sent += sizeof(cmd);
+
+    if (bus_write(d, cmd, sizeof(cmd)) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    for (int page = d->scroll_hw.page_start; page <= d->scroll_hw.page_end; page++) {
+        if (lo[page] <= hi[page])
+            *total -= hi[page] - lo[page] + 1 + WINDOW_OVERHEAD;
+        lo[page] = 0;
+        hi[page] = OLED_WIDTH - 1;
+        *total += OLED_WIDTH + WINDOW_OVERHEAD;
+    }
+    if (d->scroll_hw.vertical)
+        d->scroll_hw.start_line = -1;
+    d->scroll_hw.active = 0;
+
+    return EXIT_SUCCESS;
+}
+
+static int scroll_activate(struct oled *d, const struct scroll *want)
+{
+    // set up and start a horizontal or diagonal scroll
+
+    unsigned char cmd[13];
+    int n = 0;
+
+    cmd[n++] = COMMAND_STREAM;
+    if (want->cmd == 0x29 || want->cmd == 0x2A) {
+        cmd[n++] = 0xA3;                // vertical scroll area: whole panel
+        cmd[n++] = 0;
+        cmd[n++] = OLED_HEIGHT;
+    }
+    cmd[n++] = want->cmd;
+    cmd[n++] = 0x00;                    // dummy
+    cmd[n++] = want->page_start;
+    cmd[n++] = want->interval;
+    cmd[n++] = want->page_end;
+    if (want->cmd == 0x26 || want->cmd == 0x27) {
+        cmd[n++] = 0x00;                // dummy
+        cmd[n++] = 0xFF;                // dummy
+    } else {
+        cmd[n++] = want->vertical;
+    }
+    cmd[n++] = 0x2F;                    // activate scroll
+
+    d->flush_stats.bytes_sent += n;
+
+    if (bus_write(d, cmd, n) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    d->scroll_hw = *want;
+
+    return EXIT_SUCCESS;
+}
+
+static int set_start_line(struct oled *d, int line)
+{
+    unsigned char cmd[] = { COMMAND_STREAM, 0x40 | (line & 63) };
+
+    d->flush_stats.bytes_sent += sizeof(cmd);
+
+    if (bus_write(d, cmd, sizeof(cmd)) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    d->scroll_hw.start_line = line & 63;
+
+    return EXIT_SUCCESS;
+}
+
+static int flush_frame(struct oled *d, unsigned char *frm, const struct dirty *dirty, const struct scroll *want)
+{
+    // bring the controller in line with a frame and its scroll state
+    //
+    // dirty spans are narrowed to the bytes that differ from shadow,
+    // vertically adjacent spans are merged into one window when that is
+    // cheaper, and a full flush is used once most of the screen changed;
+    // GDDRAM must not be written while the controller scrolls, so any
+    // pixel change (or a new scroll setup) stops the scroll first
+
+    const unsigned char *pix = frm + 1;
+    int lo[OLED_PAGES], hi[OLED_PAGES];
+    int total = 0;
+    unsigned long sent_before = d->flush_stats.bytes_sent;
+    int rc = EXIT_SUCCESS;
+
+    for (int page = 0; page < OLED_PAGES; page++) {
+        const unsigned char *now = &pix[page * OLED_WIDTH];
+        const unsigned char *old = &d->shadow[page * OLED_WIDTH];
+
+        lo[page] = dirty->lo[page];
+        hi[page] = dirty->hi[page];
+        if (d->shadow_valid && lo[page] <= hi[page]) {
+            int first, last;
+
+            if (raster_diff(now + lo[page], old + lo[page], hi[page] - lo[page] + 1, &first, &last)) {
+                hi[page] = lo[page] + last;
+                lo[page] += first;
+            } else {
+                lo[page] = OLED_WIDTH;
+                hi[page] = -1;
+            }
+        }
+
+        if (lo[page] <= hi[page])
+            total += hi[page] - lo[page] + 1 + WINDOW_OVERHEAD;
+    }
+
+    if (d->scroll_hw.active && (total > 0 || !d->shadow_valid || !scroll_same(want, &d->scroll_hw)))
+        rc = scroll_deactivate(d, lo, hi, &total);
+
+    if (rc == EXIT_SUCCESS && (total > 0 || !d->shadow_valid))
+        rc = flush_pixels(d, frm, lo, hi, total);
+    else if (rc == EXIT_SUCCESS)
+        d->flush_stats.skipped++;
+
+    if (rc == EXIT_SUCCESS && want->start_line != d->scroll_hw.start_line)
+        rc = set_start_line(d, want->start_line);
+
+    if (rc == EXIT_SUCCESS && want->active && !d->scroll_hw.active)
+        rc = scroll_activate(d, want);
+
+    if (d->flush_stats.bytes_sent - sent_before < 1 + OLED_BUFFER_SIZE)
+        d->flush_stats.bytes_saved += 1 + OLED_BUFFER_SIZE - (d->flush_stats.bytes_sent - sent_before);
+
+    return rc;
+}
+
+static void flush_published(struct oled *d)
+{
+    // send the frame a panel published last, unless it was sent already
+    //
+    // only the renderer sets FRESH, only the panel's bus (worker, or the
+    // renderer leaving the bus with the bus lock held) clears it
+
+    struct frame_slot *slot;
+    struct dirty dirty;
+
+    if (!(atomic_load(&d->ready) & FRESH))
+        return;
+
+    d->flush_idx = atomic_exchange(&d->ready, d->flush_idx) & ~FRESH;
+    slot = &d->slots[d->flush_idx];
+    dirty = slot->dirty;
+    if (flush_frame(d, slot->frame, &dirty, &slot->scroll) != EXIT_SUCCESS)
+        d->flush_stats.errors++;
+    else if (slot->stamp)
+        record_latency(d, slot->stamp);
+}
+
+static void gray_take(struct oled *d)
+{
+    // switch to the gray frame published last and find where its planes
+    // differ, which is all a plane switch has to send
+
+    const unsigned char *lsb, *msb;
+
+    d->gray_show_idx = atomic_exchange(&d->gray_ready, d->gray_show_idx) & ~FRESH;
+    d->gray_shown = 1;
+    d->gray_plane = -1;
+
+    lsb = d->gray_slots[d->gray_show_idx].plane[0] + 1;
+    msb = d->gray_slots[d->gray_show_idx].plane[1] + 1;
+    dirty_clear(&d->gray_diff);
+    for (int page = 0; page < OLED_PAGES; page++) {
+        int off = page * OLED_WIDTH;
+        int first, last;
+
+        if (raster_diff(lsb + off, msb + off, OLED_WIDTH, &first, &last))
+            dirty_mark(&d->gray_diff, off + first, off + last);
+    }
+}
+
+static void gray_subframe(struct oled *d, uint64_t now)
+{
+    // show the plane of the current subframe; a new gray frame is only
+    // taken at the start of a cycle, so every cycle has the right weights
+
+    static const struct scroll still = { 0 };
+    struct dirty dirty;
+    int plane;
+
+    if (d->gray_tick == 0 && (atomic_load(&d->gray_ready) & FRESH))
+        gray_take(d);
+
+    plane = gray_cycle[d->gray_tick];
+    if (d->gray_shown && plane != d->gray_plane) {
+        // after a new frame, the plane is narrowed against shadow instead
+        if (d->gray_plane < 0) {
+            dirty_clear(&dirty);
+            dirty_mark(&dirty, 0, OLED_BUFFER_SIZE - 1);
+        } else {
+            dirty = d->gray_diff;
+        }
+
+        if (flush_frame(d, d->gray_slots[d->gray_show_idx].plane[plane], &dirty, &still) != EXIT_SUCCESS) {
+            d->flush_stats.errors++;
+            d->gray_plane = -1;
+        } else {
+            d->flush_stats.plane_switches++;
+            d->gray_plane = plane;
+        }
+    }
+    if (d->gray_shown)
+        d->flush_stats.planes++;
+
+    d->gray_tick = (d->gray_tick + 1) % GRAY_SUBFRAMES;
+    d->gray_next += d->gray_period;
+
+    // the bus could not keep up, restart the cadence rather than rush
+    // through the missed subframes
+    if (d->gray_next <= now) {
+        d->flush_stats.plane_late++;
+        d->gray_next = now + d->gray_period;
+    }
+}
+
+static void *flush_worker(void *arg)
+{
+    // bus worker: sends the most recent published frame of every panel
+    // on one adapter, one panel after the other, and the bit-planes of
+    // panels in grayscale mode when their subframe is due
+
+    struct flush_bus *b = arg;
+    uint64_t due = 0;                   // next subframe deadline, 0 = none
+    int running = 1;
+    sigset_t mask;
+
+    // leave signal handling to the application threads
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    while (running) {
+        if (due) {
+            struct timespec ts = { due / 1000000000ull, due % 1000000000ull };
+
+            sem_clockwait(&b->sem, CLOCK_MONOTONIC, &ts);
+        } else {
+            sem_wait(&b->sem);
+        }
+        running = atomic_load(&b->running);
+
+        pthread_mutex_lock(&b->lock);
+        for (int i = 0; i < b->count; i++) {
+            struct oled *d = b->panels[(b->next + i) % b->count];
+
+            // frames of a panel in grayscale mode wait until it ends
+            if (!d->gray_period)
+                flush_published(d);
+        }
+        if (b->count)
+            b->next = (b->next + 1) % b->count;
+
+        due = 0;
+        for (int i = 0; i < b->count; i++) {
+            struct oled *d = b->panels[i];
+
+            if (!d->gray_period)
+                continue;
+            if (d->gray_next <= monotonic_ns())
+                gray_subframe(d, monotonic_ns());
+            if (!due || d->gray_next < due)
+                due = d->gray_next;
+        }
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    return NULL;
+}
+
+static struct flush_bus *bus_join(struct oled *d)
+{
+    // add a panel to the queue of its adapter, starting the adapter's
+    // worker for the first panel
+
+    struct flush_bus *b = NULL;
+
+    pthread_mutex_lock(&buses_lock);
+
+    for (int i = 0; i < OLED_MAX_BUSES; i++) {
+        if (buses[i].count && !strcmp(buses[i].dev, d->dev)) {
+            b = &buses[i];
+            break;
+        }
+        if (!b && !buses[i].count)
+            b = &buses[i];
+    }
+    if (b && b->count == OLED_BUS_PANELS)
+        b = NULL;
+
+    if (b && !b->count) {
+        snprintf(b->dev, sizeof(b->dev), "%s", d->dev);
+        b->next = 0;
+        if (sem_init(&b->sem, 0, 0) != 0) {
+            b = NULL;
+        } else {
+            pthread_mutex_init(&b->lock, NULL);
+            atomic_store(&b->running, 1);
+            if (pthread_create(&b->thread, NULL, flush_worker, b) != 0) {
+                pthread_mutex_destroy(&b->lock);
+                sem_destroy(&b->sem);
+                b = NULL;
+            }
+        }
+    }
+
+    if (b) {
+        pthread_mutex_lock(&b->lock);
+        b->panels[b->count++] = d;
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    pthread_mutex_unlock(&buses_lock);
+
+    return b;
+}
+
+static void bus_leave(struct oled *d)
+{
+    // take a panel off its queue after sending its last published frame,
+    // the worker is joined once the queue is empty
+
+    struct flush_bus *b = d->queue;
+    int last;
+
+    pthread_mutex_lock(&buses_lock);
+
+    pthread_mutex_lock(&b->lock);
+    flush_published(d);
+    for (int i = 0; i < b->count; i++) {
+        if (b->panels[i] == d) {
+            b->panels[i] = b->panels[--b->count];
+            break;
+        }
+    }
+    b->next = 0;
+    last = !b->count;
+    pthread_mutex_unlock(&b->lock);
+
+    if (last) {
+        atomic_store(&b->running, 0);
+        sem_post(&b->sem);
+        pthread_join(b->thread, NULL);
+        pthread_mutex_destroy(&b->lock);
+        sem_destroy(&b->sem);
+    }
+
+    pthread_mutex_unlock(&buses_lock);
+}
+
+int oled_start_flush_thread()
+{
+    // move bus I/O of the selected panel to the worker of its adapter,
+    // oled_redraw() only publishes
+
+    struct oled *d = cur;
+
+    if (d->queue)
+        return EXIT_SUCCESS;
+
+    dirty_clear(&d->unconsumed);
+    d->queue = bus_join(d);
+
+    return d->queue ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void oled_stop_flush_thread()
+{
+    // flush the last published frame and take the selected panel off its
+    // bus worker, which is joined with the last panel on its adapter
+
+    struct oled *d = cur;
+
+    if (!d->queue)
+        return;
+
+    oled_gray_stop();
+    bus_leave(d);
+    d->queue = NULL;
 }
 
 int oled_redraw()
 {
     // push buffer to GDDRAM to display it
+    //
+    // with the panel on its bus worker, the frame is published instead
+    // and the call returns without waiting for the bus
+
+    struct oled *d = cur;
+    struct frame_slot *slot = &d->slots[d->draw_idx];
+    struct dirty dirty;
+    int prev;
+
+    atomic_fetch_add_explicit(&d->frames, 1, memory_order_relaxed);
+
+    if (!d->queue) {
+        int rc = flush_frame(d, slot->frame, &d->pending, &d->scroll_want);
+
+        dirty_clear(&d->pending);
+        if (rc != EXIT_SUCCESS)
+            d->flush_stats.errors++;
+        else if (d->stamp_pending)
+            record_latency(d, d->stamp_pending);
+        d->stamp_pending = 0;
+
+        return rc;
+    }
+
+    // the published frame carries every change since the last frame the
+    // worker took, so skipping a coalesced frame loses nothing
+    dirty = d->unconsumed;
+    dirty_merge(&dirty, &d->pending);
+    slot->dirty = dirty;
+    slot->scroll = d->scroll_want;
+
+    // a frame replaced before being sent hands its tag on, which is only
+    // known for sure at the moment of the exchange
+    prev = atomic_load(&d->ready);
+    do {
+        slot->stamp = (prev & FRESH) && d->stamp_published ? d->stamp_published : d->stamp_pending;
+    } while (!atomic_compare_exchange_weak(&d->ready, &prev, d->draw_idx | FRESH));
+    d->stamp_published = slot->stamp;
+
+    if (prev & FRESH) {
+        atomic_fetch_add_explicit(&d->coalesced, 1, memory_order_relaxed);
+        d->unconsumed = dirty;
+    } else {
+        d->unconsumed = d->pending;
+    }
+    dirty_clear(&d->pending);
+    d->stamp_pending = 0;
 
-    return i2c_write_nreg(OLED_I2C_DEV, OLED_I2C_ADDR, DATA, buffer, 1024);
+    // keep drawing on top of the frame that was just published
+    d->draw_idx = prev & ~FRESH;
+    memcpy(d->slots[d->draw_idx].frame + 1, slot->frame + 1, OLED_BUFFER_SIZE);
+    if (target == OLED_DISPLAY)
+        buffer = d->slots[d->draw_idx].frame + 1;
+
+    sem_post(&d->queue->sem);
+
+    return EXIT_SUCCESS;
+}
+
+static void scroll_request(int cmd, int page_start, int page_end, int interval, int vertical)
+{
+    // the SH1106 has no scroll commands, the content just stays put
+    if (!OLED_HW_SCROLL)
+        return;
+
+    cur->scroll_want.active = 1;
+    cur->scroll_want.cmd = cmd;
+    cur->scroll_want.page_start = page_start & (OLED_PAGES - 1);
+    cur->scroll_want.page_end = page_end & (OLED_PAGES - 1);
+    cur->scroll_want.interval = interval & 7;
+    cur->scroll_want.vertical = vertical & 63;
+}
+
+void oled_scroll_horizontal(int dir, int page_start, int page_end, int interval)
+{
+    // let the controller scroll pages [page_start, page_end] horizontally
+    //
+    // dir:         1 = right, -1 = left
+    // interval:    SSD1306 step interval code (0 = 5 frames, 1 = 64,
+    //              2 = 128, 3 = 256, 4 = 3, 5 = 4, 6 = 25, 7 = 2)
+    //
+    // takes effect with the next oled_redraw(); a later redraw that
+    // changes pixels stops the scroll, rewrites the scrolled pages from
+    // the buffer and restarts it, so the buffer stays the reference
+
+    scroll_request(dir > 0 ? 0x26 : 0x27, page_start, page_end, interval, 0);
+}
+
+void oled_scroll_diagonal(int dir, int page_start, int page_end, int interval, int vertical)
+{
+    // like oled_scroll_horizontal(), the start line additionally moves
+    // by vertical rows per step (whole panel is the vertical scroll area)
+
+    scroll_request(dir > 0 ? 0x29 : 0x2A, page_start, page_end, interval, vertical);
+}
+
+void oled_scroll_stop()
+{
+    // stop hardware scrolling with the next oled_redraw()
+
+    cur->scroll_want.active = 0;
+}
+
+void oled_set_start_line(int line)
+{
+    // map GDDRAM row line to the top of the glass (0x40 | line)
+    //
+    // buffer keeps GDDRAM coordinates, the glass shows it rotated up by
+    // line rows; 2 command bytes per step instead of a frame transfer
+
+    cur->scroll_want.start_line = line & 63;
 }
 
 void oled_clear_buffer()
 {
     // clear buffer
 
-    memset(buffer, 0, sizeof(unsigned char) * 1024);
+    raster_fill(buffer, 0, OLED_BUFFER_SIZE);
+    mark_dirty(0, OLED_BUFFER_SIZE - 1);
 }
 
 void oled_draw_pixel(int x, int y)
 {
     // draw a pixel in buffer
-    //      0 <= x <= 127
-    //      0 <= y <= 63
+    //      0 <= x < OLED_WIDTH
+    //      0 <= y < OLED_HEIGHT
     //
     //  0------------------127>  X axis
     //  |
@@ -131,7 +1255,10 @@ void oled_draw_pixel(int x, int y)
     //  63
     //  \/  Y axis
 
-    buffer[((y & 0xf8) << 4) + x] |= 1 << (y & 7);
+    int i = (y >> 3) * OLED_WIDTH + x;
+
+    buffer[i] |= 1 << (y & 7);
+    mark_dirty(i, i);
 }
 
 void oled_draw_char(int row, int col, unsigned char *font, int offset)
@@ -143,15 +1270,22 @@ void oled_draw_char(int row, int col, unsigned char *font, int offset)
     // col:     number of columns occupied by character,
     //          1 col == 1 bit, 1 <= col <= 128
     // font:    font of character
-    // offset:  begin position (index of buffer), 0 <= offset <= 1023
+    // offset:  begin position (index of buffer), 0 <= offset < OLED_BUFFER_SIZE
     //
     // returns: void
 
     int i = 0;
 
+    // characters reaching below the panel (LINE3/LINE4 on 128x32) are dropped
+    if (offset < 0 || offset + (row - 1) * OLED_WIDTH + col > OLED_BUFFER_SIZE)
+        return;
+
     for (int c = 0; c < col; c++)
         for (int r = 0; r < row; r++)
-            buffer[offset + (r << 7) + c] = font[i++];
+            buffer[offset + r * OLED_WIDTH + c] = font[i++];
+
+    for (int r = 0; r < row; r++)
+        mark_dirty(offset + r * OLED_WIDTH, offset + r * OLED_WIDTH + col - 1);
 }
 
 void oled_print(char *str, int offset)
@@ -159,7 +1293,7 @@ void oled_print(char *str, int offset)
     // prints a string
     //
     // str:     length <= 16, end with \0
-    // offset:  begin position (index of buffer), 0 <= offset <= 1023
+    // offset:  begin position (index of buffer), 0 <= offset < OLED_BUFFER_SIZE
     //
     // returns: void
 
@@ -173,46 +1307,350 @@ void oled_draw_bitmap_xy(int x, int y, int width, int height, const unsigned cha
 {
     // draws a monochrome bitmap at pixel position (x, y)
     //
-    // x, y:      top-left pixel (0 ≤ x < 128, 0 ≤ y < 64)
+    // x, y:      top-left pixel (0 ≤ x < OLED_WIDTH, 0 ≤ y < OLED_HEIGHT)
     // width:     width of bitmap (in pixels)
     // height:    height of bitmap (in pixels, multiple of 8)
     // bitmap:    pointer to packed data (vertical slices, SSD1306 native format)
     //
     // assumes bitmap is stored as: row0_col0, row1_col0, ..., rowN_col0, row0_col1, ...
 
-    if (!bitmap || x < 0 || y < 0 || x + width > 128 || y + height > 64)
+    if (!bitmap || x < 0 || y < 0 || x + width > OLED_WIDTH || y + height > OLED_HEIGHT)
         return;
 
     int rows = height / 8;
-    int offset = (y << 4) + x;
+    int offset = (y >> 3) * OLED_WIDTH + x;
 
     int i = 0;
     for (int c = 0; c < width; c++) {
         for (int r = 0; r < rows; r++) {
-            buffer[offset + (r << 7) + c] = bitmap[i++];
+            buffer[offset + r * OLED_WIDTH + c] = bitmap[i++];
         }
     }
+
+    for (int r = 0; r < rows; r++)
+        mark_dirty(offset + r * OLED_WIDTH, offset + r * OLED_WIDTH + width - 1);
 }
 
 void oled_draw_text_xy(int x, int y, const char *str)
 {
     // draws a string at pixel (x, y), each char is 8x16 (cols x rows)
     //
-    // x: horizontal pixel position (0–127)
+    // x: horizontal pixel position (0 to OLED_WIDTH - 1)
     // y: vertical pixel position (must be multiple of 8, i.e. 0, 8, 16, ...)
     // str: null-terminated string
 
-    if (x < 0 || x >= 128 || y < 0 || y > 56 || (y % 8) != 0)
+    if (x < 0 || x >= OLED_WIDTH || y < 0 || y > OLED_HEIGHT - 8 || (y % 8) != 0)
         return;  // invalid input or not aligned to 8px rows
 
     int row = 2;       // 16px height → 2 rows (each row = 8px)
     int col = 8;       // 8px wide
-    int offset = (y << 4) + x;
+    int offset = (y >> 3) * OLED_WIDTH + x;
 
-    while (*str && offset <= 1023 - col) {
+    while (*str && offset <= OLED_BUFFER_SIZE - 1 - col) {
         if (*str >= 32 && *str <= 126)
             oled_draw_char(row, col, ascii_font_2x8[*str - 32], offset);
         offset += col;
         str++;
     }
-}
\ No newline at end of file
+}
+
+void oled_blit_columns(int x, int page, int width, int bytes, const unsigned char *cols, const unsigned char *mask)
+{
+    // store column-major data (bytes per column, top page first) from
+    // column x of page on, only the bits set in mask[k] change on page
+    // page + k; clipped to the panel
+    //
+    // with the data already shifted to the pixel row, unaligned glyphs
+    // and sprites cost one masked store per byte (see font.c)
+
+    int c0 = x < 0 ? -x : 0;
+    int c1 = x + width > OLED_WIDTH ? OLED_WIDTH - x : width;
+
+    if (c0 >= c1)
+        return;
+
+    for (int k = 0; k < bytes; k++) {
+        int p = page + k;
+        int base = p * OLED_WIDTH + x;
+
+        if (p < 0 || p >= OLED_PAGES || !mask[k])
+            continue;
+
+        for (int c = c0; c < c1; c++)
+            buffer[base + c] = (buffer[base + c] & ~mask[k]) | (cols[c * bytes + k] & mask[k]);
+
+        mark_dirty(base + c0, base + c1 - 1);
+    }
+}
+
+// graphics primitives
+//
+// all primitives are clipped to the clip rectangle; vertical runs are
+// written one page byte at a time with a mask for partial pages, since
+// a byte holds 8 vertically adjacent pixels
+
+static int clip_x0 = 0, clip_y0 = 0;
+static int clip_x1 = OLED_WIDTH - 1, clip_y1 = OLED_HEIGHT - 1;
+
+static inline void apply(unsigned char *b, unsigned char mask, int color)
+{
+    if (color == OLED_COLOR_ON)
+        *b |= mask;
+    else if (color == OLED_COLOR_OFF)
+        *b &= ~mask;
+    else
+        *b ^= mask;
+}
+
+static void plot(int x, int y, int color)
+{
+    if (x < clip_x0 || x > clip_x1 || y < clip_y0 || y > clip_y1)
+        return;
+
+    int i = (y >> 3) * OLED_WIDTH + x;
+
+    apply(&buffer[i], 1 << (y & 7), color);
+    mark_dirty(i, i);
+}
+
+static void fill_area(int x0, int y0, int x1, int y1, int color)
+{
+    // fill the inclusive rectangle page by page with masked bytes
+
+    if (x0 < clip_x0)
+        x0 = clip_x0;
+    if (y0 < clip_y0)
+        y0 = clip_y0;
+    if (x1 > clip_x1)
+        x1 = clip_x1;
+    if (y1 > clip_y1)
+        y1 = clip_y1;
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    for (int page = y0 >> 3; page <= (y1 >> 3); page++) {
+        unsigned char mask = 0xFF;
+        unsigned char *row = &buffer[page * OLED_WIDTH];
+
+        if (page == (y0 >> 3))
+            mask &= 0xFF << (y0 & 7);
+        if (page == (y1 >> 3))
+            mask &= 0xFF >> (7 - (y1 & 7));
+
+        for (int x = x0; x <= x1; x++)
+            apply(&row[x], mask, color);
+
+        mark_dirty(page * OLED_WIDTH + x0, page * OLED_WIDTH + x1);
+    }
+}
+
+void oled_set_clip(int x, int y, int width, int height)
+{
+    // restrict all primitives to a rectangle (intersected with the panel)
+
+    clip_x0 = x < 0 ? 0 : x;
+    clip_y0 = y < 0 ? 0 : y;
+    clip_x1 = x + width - 1 > OLED_WIDTH - 1 ? OLED_WIDTH - 1 : x + width - 1;
+    clip_y1 = y + height - 1 > OLED_HEIGHT - 1 ? OLED_HEIGHT - 1 : y + height - 1;
+}
+
+void oled_reset_clip()
+{
+    oled_set_clip(0, 0, OLED_WIDTH, OLED_HEIGHT);
+}
+
+void oled_draw_hline(int x, int y, int width, int color)
+{
+    if (width > 0)
+        fill_area(x, y, x + width - 1, y, color);
+}
+
+void oled_draw_vline(int x, int y, int height, int color)
+{
+    if (height > 0)
+        fill_area(x, y, x, y + height - 1, color);
+}
+
+void oled_fill_rect(int x, int y, int width, int height, int color)
+{
+    if (width > 0 && height > 0)
+        fill_area(x, y, x + width - 1, y + height - 1, color);
+}
+
+void oled_draw_rect(int x, int y, int width, int height, int color)
+{
+    // outline, every pixel is touched once (matters for OLED_COLOR_INVERT)
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    oled_draw_hline(x, y, width, color);
+    if (height > 1)
+        oled_draw_hline(x, y + height - 1, width, color);
+    oled_draw_vline(x, y + 1, height - 2, color);
+    if (width > 1)
+        oled_draw_vline(x + width - 1, y + 1, height - 2, color);
+}
+
+void oled_draw_line(int x0, int y0, int x1, int y1, int color)
+{
+    // Bresenham line, axis-parallel lines become byte spans
+
+    int dx, dy, sx, sy, err;
+
+    if (y0 == y1) {
+        oled_draw_hline(x0 < x1 ? x0 : x1, y0, abs(x1 - x0) + 1, color);
+        return;
+    }
+    if (x0 == x1) {
+        oled_draw_vline(x0, y0 < y1 ? y0 : y1, abs(y1 - y0) + 1, color);
+        return;
+    }
+
+    dx = abs(x1 - x0);
+    dy = -abs(y1 - y0);
+    sx = x0 < x1 ? 1 : -1;
+    sy = y0 < y1 ? 1 : -1;
+    err = dx + dy;
+
+    while (1) {
+        plot(x0, y0, color);
+        if (x0 == x1 && y0 == y1)
+            break;
+
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+static void plot4(int cx, int cy, int x, int y, int color)
+{
+    // mirror a circle point into 4 quadrants without duplicates
+
+    plot(cx + x, cy + y, color);
+    if (x)
+        plot(cx - x, cy + y, color);
+    if (y)
+        plot(cx + x, cy - y, color);
+    if (x && y)
+        plot(cx - x, cy - y, color);
+}
+
+void oled_draw_circle(int cx, int cy, int r, int color)
+{
+    // midpoint circle outline
+
+    int x = 0, y = r, d = 1 - r;
+
+    if (r < 0)
+        return;
+
+    while (x <= y) {
+        plot4(cx, cy, x, y, color);
+        if (x != y)
+            plot4(cx, cy, y, x, color);
+
+        x++;
+        if (d < 0) {
+            d += 2 * x + 1;
+        } else {
+            y--;
+            d += 2 * (x - y) + 1;
+        }
+    }
+}
+
+void oled_fill_circle(int cx, int cy, int r, int color)
+{
+    // filled circle as one vertical span per column
+
+    int dy = r;
+
+    if (r < 0)
+        return;
+
+    for (int dx = 0; dx <= r; dx++) {
+        while (dx * dx + dy * dy > r * r + r)
+            dy--;
+
+        oled_draw_vline(cx + dx, cy - dy, 2 * dy + 1, color);
+        if (dx)
+            oled_draw_vline(cx - dx, cy - dy, 2 * dy + 1, color);
+    }
+}
+
+int oled_gray_start(int plane_hz)
+{
+    // switch the selected panel to 2-bit grayscale, subframes are shown
+    // at plane_hz (three per gray cycle) by its bus worker
+    //
+    // needs the panel on its bus worker (oled_start_flush_thread()); the
+    // planes come from oled_gray_publish(), frames from oled_redraw()
+    // are held back until oled_gray_stop()
+
+    struct oled *d = cur;
+    struct flush_bus *b = d->queue;
+
+    if (!b || plane_hz <= 0)
+        return EXIT_FAILURE;
+
+    pthread_mutex_lock(&b->lock);
+    d->gray_period = 1000000000ull / plane_hz;
+    d->gray_tick = 0;
+    d->gray_plane = -1;
+    d->gray_next = monotonic_ns();
+    pthread_mutex_unlock(&b->lock);
+
+    // let the worker pick up the new deadline
+    sem_post(&b->sem);
+
+    return EXIT_SUCCESS;
+}
+
+void oled_gray_stop()
+{
+    // leave grayscale mode, the frame held back (or the next one from
+    // oled_redraw()) is sent in full over the last plane shown
+
+    struct oled *d = cur;
+    struct flush_bus *b = d->queue;
+
+    if (!b || !d->gray_period)
+        return;
+
+    pthread_mutex_lock(&b->lock);
+    d->gray_period = 0;
+    d->shadow_valid = 0;
+    pthread_mutex_unlock(&b->lock);
+
+    sem_post(&b->sem);
+}
+
+int oled_gray_publish(const unsigned char *msb, const unsigned char *lsb)
+{
+    // hand the worker the two bit-planes (OLED_BUFFER_SIZE bytes each,
+    // page layout) of a gray frame; like oled_redraw(), a frame not
+    // shown yet is replaced
+
+    struct oled *d = cur;
+    struct gray_slot *slot = &d->gray_slots[d->gray_draw_idx];
+
+    if (!d->gray_period)
+        return EXIT_FAILURE;
+
+    slot->plane[0][0] = DATA;
+    slot->plane[1][0] = DATA;
+    memcpy(slot->plane[0] + 1, lsb, OLED_BUFFER_SIZE);
+    memcpy(slot->plane[1] + 1, msb, OLED_BUFFER_SIZE);
+
+    d->gray_draw_idx = atomic_exchange(&d->gray_ready, d->gray_draw_idx | FRESH) & ~FRESH;
+
+    return EXIT_SUCCESS;
+}
@@ -1,23 +1,120 @@
 #pragma once
 
-// commonly used offsets
-#define LINE1	  0
-#define LINE2	256
-#define LINE3	512
-#define LINE4	768
+#include <stdint.h>
+
+#include "panel.h"
+
+// commonly used offsets (one 8x16 text line per two pages), lines below
+// the panel are dropped by the drawing calls
+#define LINE1	(0 * OLED_WIDTH)
+#define LINE2	(2 * OLED_WIDTH)
+#define LINE3	(4 * OLED_WIDTH)
+#define LINE4	(6 * OLED_WIDTH)
+
+// primitive colors
+#define OLED_COLOR_OFF      0
+#define OLED_COLOR_ON       1
+#define OLED_COLOR_INVERT   2
+
+// draw targets: the display buffer or an off-screen canvas (one frame each)
+#define OLED_DISPLAY        -1
+#define OLED_CANVAS_MAX      4
+
+// a panel, see oled_open(); every other call acts on the selected one
+//
+// the selection (oled_select(), oled_select_canvas()), the clip rectangle
+// and the canvases are process-wide and unlocked, so drawing, selecting,
+// presenting and oled_redraw() must all come from one thread; the bus
+// workers only take the frames oled_redraw() published, and
+// oled_get_flush_stats() may be called from any thread once the panel is
+// on its worker
+struct oled;
+
+// byte transport to the controller, one call per I2C write transaction
+struct oled_transport {
+    int (*write)(void *ctx, unsigned char *buf, int count);
+    void *ctx;
+};
+
+// flush counters (see oled_get_flush_stats)
+struct oled_flush_stats {
+    unsigned long frames;           // oled_redraw() calls
+    unsigned long full_flushes;     // whole-frame transfers
+    unsigned long partial_flushes;  // frames sent as dirty windows
+    unsigned long skipped;          // frames identical to GDDRAM
+    unsigned long coalesced;        // frames replaced before being sent
+    unsigned long errors;           // failed flushes
+    unsigned long bytes_sent;       // control, command and pixel bytes
+    unsigned long bytes_saved;      // compared to a full flush per frame
+    unsigned long stamped;          // frames tagged with an input event
+    uint64_t latency_last_ns;       // input event to flush completion
+    uint64_t latency_max_ns;
+    uint64_t latency_total_ns;
+    unsigned long planes;           // grayscale subframes shown
+    unsigned long plane_switches;   // subframes that needed a transfer
+    unsigned long plane_late;       // subframes the bus could not keep up with
+};
 
 // functions
+struct oled *oled_open(const char *dev, int addr);
+void oled_close(struct oled *d);
+struct oled *oled_select(struct oled *d);
+void oled_set_transport(struct oled_transport *t);
 int oled_init();
 int oled_turn_on_off(int state);
 int oled_redraw();
+int oled_start_flush_thread();
+void oled_stop_flush_thread();
 void oled_clear_buffer();
 void oled_draw_pixel(int x, int y);
 void oled_draw_char(int row, int col, unsigned char *font, int offset);
 void oled_print(char *str, int offset);
 
+// hardware scrolling, applied with the next oled_redraw(); ignored on
+// panels without scroll commands (OLED_HW_SCROLL)
+void oled_scroll_horizontal(int dir, int page_start, int page_end, int interval);
+void oled_scroll_diagonal(int dir, int page_start, int page_end, int interval, int vertical);
+void oled_scroll_stop();
+void oled_set_start_line(int line);
+
 // new graphics API
 void oled_draw_bitmap_xy(int x, int y, int width, int height, const unsigned char *bitmap);
 void oled_draw_text_xy(int x, int y, const char *str);
 
-// access raw internal buffer
-unsigned char *oled_get_buffer();
\ No newline at end of file
+// masked column-major blit at any page, the font engine's glyph path
+void oled_blit_columns(int x, int page, int width, int bytes, const unsigned char *cols, const unsigned char *mask);
+
+// graphics primitives (clipped, see OLED_COLOR_*)
+void oled_set_clip(int x, int y, int width, int height);
+void oled_reset_clip();
+void oled_draw_hline(int x, int y, int width, int color);
+void oled_draw_vline(int x, int y, int height, int color);
+void oled_draw_line(int x0, int y0, int x1, int y1, int color);
+void oled_draw_rect(int x, int y, int width, int height, int color);
+void oled_fill_rect(int x, int y, int width, int height, int color);
+void oled_draw_circle(int cx, int cy, int r, int color);
+void oled_fill_circle(int cx, int cy, int r, int color);
+
+// access raw internal buffer (marks the whole frame dirty)
+unsigned char *oled_get_buffer();
+
+// changes whenever anything is drawn into the buffer
+unsigned long oled_get_generation();
+
+// draw into an off-screen canvas (0..OLED_CANVAS_MAX-1) or OLED_DISPLAY
+int oled_select_canvas(int canvas);
+
+// copy a canvas into the display buffer, marking only changed bytes dirty
+int oled_present_canvas(int canvas);
+
+// 2-bit grayscale by temporal dithering of two bit-planes, see gray.h
+int oled_gray_start(int plane_hz);
+void oled_gray_stop();
+int oled_gray_publish(const unsigned char *msb, const unsigned char *lsb);
+
+// dirty-region flush statistics
+void oled_get_flush_stats(struct oled_flush_stats *stats);
+
+// tag the next frame with an input event time (CLOCK_MONOTONIC ns), the
+// flush records how long the event took to reach the panel
+void oled_set_frame_stamp(uint64_t ns);
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+// panel profiles
+//
+// geometry and controller quirks are compile-time constants, selected by
+// make PANEL=... (see Makefile), so every loop over pages and columns is
+// constant-folded for the one panel a binary is built for
+//
+//   ssd1306          0.96" SSD1306 128x64 (NanoHat OLED), the default
+//   ssd1306_128x32   0.91" SSD1306 128x32
+//   sh1106           1.3" SH1106 128x64, 132-column GDDRAM, page addressing only
+
+#if defined(PANEL_SH1106)
+#define OLED_CONTROLLER     "sh1106"
+#define OLED_HEIGHT         64
+#define OLED_RAM_COLUMNS    132         // GDDRAM columns
+#define OLED_COLUMN_OFFSET  2           // GDDRAM column of the first visible one
+#define OLED_PAGE_MODE      1           // no 0x20/0x21/0x22, one page per write
+#define OLED_HW_SCROLL      0           // no 0x26..0x2F scroll commands
+#define OLED_COM_PINS       0x12
+#elif defined(PANEL_SSD1306_128X32)
+#define OLED_CONTROLLER     "ssd1306"
+#define OLED_HEIGHT         32
+#define OLED_RAM_COLUMNS    128
+#define OLED_COLUMN_OFFSET  0
+#define OLED_PAGE_MODE      0
+#define OLED_HW_SCROLL      1
+#define OLED_COM_PINS       0x02        // sequential COM, no remap
+#else
+#define OLED_CONTROLLER     "ssd1306"
+#define OLED_HEIGHT         64
+#define OLED_RAM_COLUMNS    128
+#define OLED_COLUMN_OFFSET  0
+#define OLED_PAGE_MODE      0
+#define OLED_HW_SCROLL      1
+#define OLED_COM_PINS       0x12        // alternative COM
+#endif
+
+#define OLED_WIDTH          128
+#define OLED_PAGES          (OLED_HEIGHT / 8)
+#define OLED_BUFFER_SIZE    (OLED_WIDTH * OLED_PAGES)
+
+// both controllers keep 64 rows of GDDRAM whatever the panel shows
+#define OLED_RAM_PAGES      8
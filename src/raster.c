@@ -0,0 +1,186 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "raster.h"
+
+// scalar reference
+
+void raster_fill_ref(unsigned char *dst, unsigned char value, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = value;
+}
+
+void raster_invert_ref(unsigned char *dst, const unsigned char *src, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = ~src[i];
+}
+
+void raster_xor_ref(unsigned char *dst, const unsigned char *a, const unsigned char *b, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = a[i] ^ b[i];
+}
+
+void raster_blend_ref(unsigned char *dst, const unsigned char *src, const unsigned char *mask, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = (dst[i] & ~mask[i]) | (src[i] & mask[i]);
+}
+
+int raster_diff_ref(const unsigned char *a, const unsigned char *b, int n, int *first, int *last)
+{
+    int lo = 0, hi = n - 1;
+
+    while (lo < n && a[lo] == b[lo])
+        lo++;
+    if (lo == n)
+        return 0;
+    while (a[hi] == b[hi])
+        hi--;
+
+    *first = lo;
+    *last = hi;
+
+    return 1;
+}
+
+// vector variant
+//
+// every kernel works on 16-byte blocks and hands the tail to the
+// scalar reference; loads and stores are unaligned-safe
+
+#if defined(__ARM_NEON)
+
+typedef uint8x16_t vec;
+
+#define VLOAD(p)            vld1q_u8(p)
+#define VSTORE(p, v)        vst1q_u8(p, v)
+#define VNOT(v)             vmvnq_u8(v)
+#define VXOR(a, b)          veorq_u8(a, b)
+#define VSELECT(m, a, b)    vbslq_u8(m, a, b)
+
+static inline int vany(vec v)
+{
+    uint64x2_t w = vreinterpretq_u64_u8(v);
+
+    return (vgetq_lane_u64(w, 0) | vgetq_lane_u64(w, 1)) != 0;
+}
+
+const char *raster_variant()
+{
+    return "neon";
+}
+
+#else
+
+typedef unsigned char vec __attribute__((vector_size(16)));
+
+static inline vec vload(const unsigned char *p)
+{
+    vec v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+static inline void vstore(unsigned char *p, vec v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline int vany(vec v)
+{
+    uint64_t w[2];
+
+    memcpy(w, &v, sizeof(w));
+
+    return (w[0] | w[1]) != 0;
+}
+
+#define VLOAD(p)            vload(p)
+#define VSTORE(p, v)        vstore(p, v)
+#define VNOT(v)             (~(v))
+#define VXOR(a, b)          ((a) ^ (b))
+#define VSELECT(m, a, b)    (((a) & (m)) | ((b) & ~(m)))
+
+const char *raster_variant()
+{
+    return "vector";
+}
+
+#endif
+
+void raster_fill(unsigned char *dst, unsigned char value, int n)
+{
+    // libc memset is already vectorized for the target and beats a
+    // 16-byte store loop on short frames
+
+    memset(dst, value, n);
+}
+
+void raster_invert(unsigned char *dst, const unsigned char *src, int n)
+{
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        vec v = VNOT(VLOAD(src + i));
+        VSTORE(dst + i, v);
+    }
+
+    raster_invert_ref(dst + i, src + i, n - i);
+}
+
+void raster_xor(unsigned char *dst, const unsigned char *a, const unsigned char *b, int n)
+{
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        vec v = VXOR(VLOAD(a + i), VLOAD(b + i));
+        VSTORE(dst + i, v);
+    }
+
+    raster_xor_ref(dst + i, a + i, b + i, n - i);
+}
+
+void raster_blend(unsigned char *dst, const unsigned char *src, const unsigned char *mask, int n)
+{
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        vec m = VLOAD(mask + i);
+        vec v = VSELECT(m, VLOAD(src + i), VLOAD(dst + i));
+        VSTORE(dst + i, v);
+    }
+
+    raster_blend_ref(dst + i, src + i, mask + i, n - i);
+}
+
+int raster_diff(const unsigned char *a, const unsigned char *b, int n, int *first, int *last)
+{
+    // skip equal 16-byte blocks from both ends, the exact byte inside
+    // the boundary blocks is located by the reference
+
+    int lo = 0, hi = n;
+    int start, f, l;
+
+    while (lo + 16 <= n && !vany(VXOR(VLOAD(a + lo), VLOAD(b + lo))))
+        lo += 16;
+    if (!raster_diff_ref(a + lo, b + lo, (n - lo < 16) ? n - lo : 16, &f, &l))
+        return 0;
+    *first = lo + f;
+
+    while (hi - 16 >= *first && !vany(VXOR(VLOAD(a + hi - 16), VLOAD(b + hi - 16))))
+        hi -= 16;
+    start = (hi - 16 < *first) ? *first : hi - 16;
+    raster_diff_ref(a + start, b + start, hi - start, &f, &l);
+    *last = start + l;
+
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+// raster kernels for whole-frame operations
+//
+// the _ref functions are the scalar reference and are always built, the
+// plain names are selected at build time: NEON intrinsics when __ARM_NEON
+// is defined (aarch64, or make NEON=1 on ARMv7), GCC vector extensions
+// that the compiler vectorizes for the target otherwise
+
+// dst[i] = value
+void raster_fill(unsigned char *dst, unsigned char value, int n);
+// dst[i] = ~src[i]
+void raster_invert(unsigned char *dst, const unsigned char *src, int n);
+// dst[i] = a[i] ^ b[i]
+void raster_xor(unsigned char *dst, const unsigned char *a, const unsigned char *b, int n);
+// dst[i] = (dst[i] & ~mask[i]) | (src[i] & mask[i])
+void raster_blend(unsigned char *dst, const unsigned char *src, const unsigned char *mask, int n);
+// 1 if a and b differ, first/last receive the outermost differing indexes
+int raster_diff(const unsigned char *a, const unsigned char *b, int n, int *first, int *last);
+
+void raster_fill_ref(unsigned char *dst, unsigned char value, int n);
+void raster_invert_ref(unsigned char *dst, const unsigned char *src, int n);
+void raster_xor_ref(unsigned char *dst, const unsigned char *a, const unsigned char *b, int n);
+void raster_blend_ref(unsigned char *dst, const unsigned char *src, const unsigned char *mask, int n);
+int raster_diff_ref(const unsigned char *a, const unsigned char *b, int n, int *first, int *last);
+
+// name of the variant behind the plain names ("neon" or "vector")
+const char *raster_variant();
\ No newline at end of file
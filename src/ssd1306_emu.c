@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ssd1306_emu.h"
+
+// control byte bits
+#define CTRL_CO     0x80            // single byte follows, then a new control byte
+#define CTRL_DC     0x40            // 1 = data, 0 = command
+
+// I2C frame overhead: START + address byte with ACK + STOP
+#define BUS_OVERHEAD_BITS   (1 + 9 + 1)
+
+static int command_length(unsigned char c)
+{
+    // total length of a command including its arguments
+
+    switch (c) {
+    case 0x81:      // contrast
+    case 0x20:      // memory addressing mode
+    case 0xA8:      // multiplex ratio
+    case 0xD3:      // display offset
+    case 0xD5:      // osc division
+    case 0xD9:      // pre-charge period
+    case 0xDA:      // com pins
+    case 0xDB:      // vcomh
+    case 0x8D:      // charge pump
+    case 0xAD:      // DC-DC control (SH1106)
+        return 2;
+    case 0x21:      // column address
+    case 0x22:      // page address
+    case 0xA3:      // vertical scroll area
+        return 3;
+    case 0x29:      // vertical and right horizontal scroll
+    case 0x2A:      // vertical and left horizontal scroll
+        return 6;
+    case 0x26:      // right horizontal scroll
+    case 0x27:      // left horizontal scroll
+        return 7;
+    default:
+        return 1;
+    }
+}
+
+static void execute(struct ssd1306_emu *e)
+{
+    // apply a complete command from e->cmd
+
+    unsigned char *c = e->cmd;
+
+    switch (c[0]) {
+    case 0x81:
+        e->contrast = c[1];
+        return;
+    case 0x20:
+        e->addr_mode = c[1] & 3;
+        return;
+    case 0x21:
+        e->col_start = e->col = c[1] & 127;
+        e->col_end = c[2] & 127;
+        return;
+    case 0x22:
+        e->page_start = e->page = c[1] & 7;
+        e->page_end = c[2] & 7;
+        return;
+    case 0xA3:
+        e->vscroll_fixed = c[1] & 63;
+        e->vscroll_rows = c[2] & 127;
+        return;
+    case 0x26:
+    case 0x27:
+        e->scroll_dir = (c[0] == 0x26) ? 1 : -1;
+        e->scroll_page_start = c[2] & 7;
+        e->scroll_interval = c[3] & 7;
+        e->scroll_page_end = c[4] & 7;
+        e->scroll_vertical = 0;
+        return;
+    case 0x29:
+    case 0x2A:
+        e->scroll_dir = (c[0] == 0x29) ? 1 : -1;
+        e->scroll_page_start = c[2] & 7;
+        e->scroll_interval = c[3] & 7;
+        e->scroll_page_end = c[4] & 7;
+        e->scroll_vertical = c[5] & 63;
+        return;
+    case 0x2E:
+        e->scroll_active = 0;
+        return;
+    case 0x2F:
+        e->scroll_active = 1;
+        return;
+    case 0xA6:
+    case 0xA7:
+        e->inverse = c[0] & 1;
+        return;
+    case 0xAE:
+    case 0xAF:
+        e->display_on = c[0] & 1;
+        return;
+    }
+
+    if (c[0] >= 0x40 && c[0] <= 0x7F)
+        e->start_line = c[0] & 63;
+    else if (c[0] >= 0xB0 && c[0] <= 0xB7)
+        e->page = c[0] & 7;                             // page mode only
+    else if (c[0] <= 0x0F)
+        e->col = (e->col & 0xF0) | (c[0] & 0x0F);       // page mode only
+    else if (c[0] >= 0x10 && c[0] <= 0x1F)
+        e->col = ((e->col & 0x0F) | ((c[0] & 0x0F) << 4)) % OLED_RAM_COLUMNS;
+    // remaining commands (remap, scan direction, timing) do not affect GDDRAM
+}
+
+static void command_byte(struct ssd1306_emu *e, unsigned char b)
+{
+    if (e->cmd_len == 0)
+        e->cmd_need = command_length(b);
+
+    e->cmd[e->cmd_len++] = b;
+    e->cmd_bytes++;
+
+    if (e->cmd_len == e->cmd_need) {
+        execute(e);
+        e->cmd_len = 0;
+    }
+}
+
+static void data_byte(struct ssd1306_emu *e, unsigned char b)
+{
+    // store a byte at the RAM pointer and advance it
+
+    e->gddram[e->page * OLED_RAM_COLUMNS + e->col] = b;
+    e->data_bytes++;
+
+    switch (e->addr_mode) {
+    case 0:     // horizontal
+        if (++e->col > e->col_end) {
+            e->col = e->col_start;
+            if (++e->page > e->page_end)
+                e->page = e->page_start;
+        }
+        break;
+    case 1:     // vertical
+        if (++e->page > e->page_end) {
+            e->page = e->page_start;
+            if (++e->col > e->col_end)
+                e->col = e->col_start;
+        }
+        break;
+    default:    // page
+        e->col = (e->col + 1) % OLED_RAM_COLUMNS;
+        break;
+    }
+}
+
+void ssd1306_emu_init(struct ssd1306_emu *e, unsigned long bus_hz)
+{
+    // power-on reset state
+
+    memset(e, 0, sizeof(*e));
+
+    e->contrast = 0x7F;
+    e->addr_mode = 2;
+    e->col_end = OLED_RAM_COLUMNS - 1;
+    e->page_end = 7;
+    e->vscroll_rows = 64;
+    e->bus_hz = bus_hz ? bus_hz : 400000;
+}
+
+void ssd1306_emu_reset_stats(struct ssd1306_emu *e)
+{
+    e->bus_time_ns = 0;
+    e->transactions = 0;
+    e->bytes = 0;
+    e->cmd_bytes = 0;
+    e->data_bytes = 0;
+    e->log_pos = 0;
+    memset(e->log, 0, sizeof(e->log));
+}
+
+int ssd1306_emu_write(struct ssd1306_emu *e, unsigned char *buf, int count)
+{
+    // parse one write transaction
+    //
+    // every transaction starts with a control byte; with Co set exactly
+    // one command/data byte follows before the next control byte,
+    // otherwise the rest of the transaction is a command or data stream
+
+    int i = 0;
+
+    if (count <= 0)
+        return EXIT_FAILURE;
+
+    e->transactions++;
+    e->bytes += count;
+    e->bus_time_ns += (uint64_t)(BUS_OVERHEAD_BITS + 9 * count) * 1000000000ULL / e->bus_hz;
+    e->log[e->log_pos] = count;
+    e->log_pos = (e->log_pos + 1) % SSD1306_EMU_LOG_SIZE;
+
+    while (i < count) {
+        unsigned char ctrl = buf[i++];
+
+        if (ctrl & CTRL_CO) {
+            if (i < count) {
+                if (ctrl & CTRL_DC)
+                    data_byte(e, buf[i]);
+                else
+                    command_byte(e, buf[i]);
+                i++;
+            }
+            continue;
+        }
+
+        for (; i < count; i++) {
+            if (ctrl & CTRL_DC)
+                data_byte(e, buf[i]);
+            else
+                command_byte(e, buf[i]);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void ssd1306_emu_scroll_step(struct ssd1306_emu *e)
+{
+    // horizontal scrolling rotates the GDDRAM rows of the scrolled pages,
+    // diagonal scrolling also moves the start line inside the vertical
+    // scroll area
+
+    if (!e->scroll_active)
+        return;
+
+    for (int page = e->scroll_page_start; page <= e->scroll_page_end; page++) {
+        unsigned char *row = &e->gddram[page * OLED_RAM_COLUMNS];
+        unsigned char tmp;
+
+        if (e->scroll_dir > 0) {
+            tmp = row[OLED_RAM_COLUMNS - 1];
+            memmove(row + 1, row, OLED_RAM_COLUMNS - 1);
+            row[0] = tmp;
+        } else {
+            tmp = row[0];
+            memmove(row, row + 1, OLED_RAM_COLUMNS - 1);
+            row[OLED_RAM_COLUMNS - 1] = tmp;
+        }
+    }
+
+    if (e->scroll_vertical && e->vscroll_rows)
+        e->start_line = (e->start_line + e->scroll_vertical) % e->vscroll_rows;
+}
+
+int ssd1306_emu_pixel(struct ssd1306_emu *e, int x, int y)
+{
+    // pixel at glass position (x, y)
+
+    int row, bit;
+
+    if (!e->display_on || x < 0 || x >= OLED_WIDTH || y < 0 || y >= OLED_HEIGHT)
+        return 0;
+
+    row = (y + e->start_line) & 63;
+    bit = (e->gddram[(row >> 3) * OLED_RAM_COLUMNS + x + OLED_COLUMN_OFFSET] >> (row & 7)) & 1;
+
+    return bit ^ e->inverse;
+}
+
+static int emu_transport_write(void *ctx, unsigned char *buf, int count)
+{
+    return ssd1306_emu_write(ctx, buf, count);
+}
+
+void ssd1306_emu_transport(struct ssd1306_emu *e, struct oled_transport *t)
+{
+    t->write = emu_transport_write;
+    t->ctx = e;
+}
\ No newline at end of file
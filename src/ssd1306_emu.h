@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "oled.h"
+
+// in-process SSD1306 emulator
+//
+// parses the I2C byte stream the driver sends (control bytes, commands
+// and data) into a virtual GDDRAM and models the time each transaction
+// would occupy the bus, so render and flush paths can be verified and
+// benchmarked without the board; GDDRAM width and the visible area
+// follow the panel profile, so it stands in for the SH1106 as well
+
+#define SSD1306_EMU_LOG_SIZE    64
+
+struct ssd1306_emu {
+    // controller state
+    unsigned char gddram[OLED_RAM_PAGES * OLED_RAM_COLUMNS];
+    int display_on;
+    int inverse;
+    int contrast;
+    int start_line;                 // 0x40 | n
+    int addr_mode;                  // 0 horizontal, 1 vertical, 2 page
+    int col_start, col_end;
+    int page_start, page_end;
+    int col, page;                  // RAM pointer
+
+    // scrolling (0x26/0x27/0x29/0x2A/0xA3/0x2E/0x2F)
+    int scroll_active;
+    int scroll_dir;                 // +1 right, -1 left
+    int scroll_vertical;            // diagonal vertical offset per step
+    int scroll_page_start, scroll_page_end;
+    int scroll_interval;
+    int vscroll_fixed, vscroll_rows;
+
+    // command parser (a command may span several transactions)
+    unsigned char cmd[8];
+    int cmd_len, cmd_need;
+
+    // bus model
+    unsigned long bus_hz;
+    uint64_t bus_time_ns;           // total modelled bus time
+
+    // counters
+    unsigned long transactions;
+    unsigned long bytes;            // including control bytes
+    unsigned long cmd_bytes;
+    unsigned long data_bytes;
+    int log[SSD1306_EMU_LOG_SIZE];  // byte count of the last transactions
+    int log_pos;
+};
+
+void ssd1306_emu_init(struct ssd1306_emu *e, unsigned long bus_hz);
+void ssd1306_emu_reset_stats(struct ssd1306_emu *e);
+
+// one I2C write transaction (everything between START and STOP)
+int ssd1306_emu_write(struct ssd1306_emu *e, unsigned char *buf, int count);
+
+// advance an active scroll by one step (one scroll interval)
+void ssd1306_emu_scroll_step(struct ssd1306_emu *e);
+
+// pixel as seen on the glass (start line, inverse and display state applied)
+int ssd1306_emu_pixel(struct ssd1306_emu *e, int x, int y);
+
+// fill a transport that feeds the emulator (see oled_set_transport)
+void ssd1306_emu_transport(struct ssd1306_emu *e, struct oled_transport *t);
\ No newline at end of file
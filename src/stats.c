@@ -1,18 +1,165 @@
+#include "ipaddr.h"
 #include "stats.h"
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/statvfs.h>
 
+// sampled files stay open and are read again from offset 0 with pread(),
+// the kernel regenerates /proc and /sys contents on every read; a file
+// that fails is closed and opened again on the next sample
+struct sysfile {
+    const char *path;
+    int fd;
+};
+
+static struct sysfile meminfo = { "/proc/meminfo", -1 };
+static struct sysfile loadavg = { "/proc/loadavg", -1 };
+static struct sysfile mounts = { "/proc/mounts", -1 };
+static struct sysfile thermal = { "/sys/class/thermal/thermal_zone0/temp", -1 };
+static struct sysfile root = { "/", -1 };
+
+static int sysfile_fd(struct sysfile *f)
+{
+    if (f->fd < 0)
+        f->fd = open(f->path, O_RDONLY | O_CLOEXEC);
+
+    return f->fd;
+}
+
+static void sysfile_drop(struct sysfile *f)
+{
+    close(f->fd);
+    f->fd = -1;
+}
+
+static ssize_t sysfile_read(struct sysfile *f, char *buf, size_t size, off_t offset)
+{
+    // up to size bytes at offset, not terminated
+
+    ssize_t n;
+
+    if (sysfile_fd(f) < 0)
+        return -1;
+
+    n = pread(f->fd, buf, size, offset);
+    if (n < 0)
+        sysfile_drop(f);
+
+    return n;
+}
+
+// scanners over [p, end): no allocation, no locale, no stdio
+
+static const char *skip_spaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    return p;
+}
+
+static const char *scan_ulong(const char *p, const char *end, unsigned long *v)
+{
+    // decimal digits after any blanks, NULL when there are none
+
+    unsigned long n = 0;
+    const char *start;
+
+    p = skip_spaces(p, end);
+    for (start = p; p < end && *p >= '0' && *p <= '9'; p++)
+        n = n * 10 + (*p - '0');
+    if (p == start)
+        return NULL;
+
+    *v = n;
+    return p;
+}
+
+static const char *scan_hundredths(const char *p, const char *end, unsigned long *v)
+{
+    // "12.34" as 1234, digits past the second decimal are dropped
+
+    unsigned long n;
+    int digits = 0;
+
+    if (!(p = scan_ulong(p, end, &n)))
+        return NULL;
+
+    if (p < end && *p == '.')
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+            if (digits < 2) {
+                n = n * 10 + (*p - '0');
+                digits++;
+            }
+    for (; digits < 2; digits++)
+        n *= 10;
+
+    *v = n;
+    return p;
+}
+
+static const char *next_line(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', end - p);
+
+    return nl ? nl + 1 : end;
+}
+
+static int root_mounted()
+{
+    // look for a "/" mount point in /proc/mounts, read in chunks with a
+    // partial last line carried over, stopping at the first match
+
+    char buf[1024];
+    size_t keep = 0;
+    off_t offset = 0;
+    ssize_t n;
+
+    while ((n = sysfile_read(&mounts, buf + keep, sizeof(buf) - keep, offset)) > 0) {
+        const char *end = buf + keep + n;
+        const char *line = buf;
+        const char *nl;
+
+        offset += n;
+        while ((nl = memchr(line, '\n', end - line))) {
+            // device, then the mount point
+            const char *p = memchr(line, ' ', nl - line);
+
+            if (p && nl - p > 2 && p[1] == '/' && p[2] == ' ')
+                return 1;
+            line = nl + 1;
+        }
+
+        // a line longer than the buffer is skipped
+        keep = end - line;
+        if (keep == sizeof(buf))
+            keep = 0;
+        memmove(buf, line, keep);
+    }
+
+    return 0;
+}
+
 void get_ip(char *out, size_t out_size)
 {
+    // the address tracker's table, `hostname -I` only when it is not running
+
+    char ip[64] = {0};
+    int rc = ipaddr_primary(ip, sizeof(ip));
+
+    if (rc >= 0) {
+        snprintf(out, out_size, "IP:%13s", ip);
+        return;
+    }
+
     FILE *fp = popen("hostname -I", "r");
     if (!fp) {
         snprintf(out, out_size, "IP: unavailable");
         return;
     }
-    char ip[64] = {0};
     fgets(ip, sizeof(ip), fp);
     pclose(fp);
     ip[strcspn(ip, " \n")] = '\0';
@@ -21,29 +168,14 @@ void get_ip(char *out, size_t out_size)
 
 void get_disk_usage(char *out, size_t out_size)
 {
-    FILE *fp = fopen("/proc/mounts", "r");
-    if (!fp) {
-        snprintf(out, out_size, "/: error");
-        return;
-    }
-
-    int found = 0;
-    char dev[64], mount[64], type[32];
-    while (fscanf(fp, "%63s %63s %31s", dev, mount, type) == 3) {
-        if (strcmp(mount, "/") == 0) {
-            found = 1;
-            break;
-        }
-    }
-    fclose(fp);
+    struct statvfs vfs;
 
-    if (!found) {
-        snprintf(out, out_size, "/: not mounted");
+    if (!root_mounted()) {
+        snprintf(out, out_size, sysfile_fd(&mounts) < 0 ? "/: error" : "/: not mounted");
         return;
     }
 
-    struct statvfs vfs;
-    if (statvfs("/", &vfs) != 0) {
+    if (sysfile_fd(&root) < 0 || fstatvfs(root.fd, &vfs) != 0) {
         snprintf(out, out_size, "/: error");
         return;
     }
@@ -62,20 +194,34 @@ void get_disk_usage(char *out, size_t out_size)
 
 void get_mem_usage(char *out, size_t out_size)
 {
-    FILE *fp = fopen("/proc/meminfo", "r");
-    if (!fp) {
+    // MemTotal and MemAvailable are the first and third lines, the scan
+    // stops once both were seen
+
+    char buf[512];
+    const char *p, *end;
+    unsigned long mem_total = 0, mem_available = 0;
+    int found = 0;
+    ssize_t n;
+
+    n = sysfile_read(&meminfo, buf, sizeof(buf), 0);
+    if (n < 0) {
         snprintf(out, out_size, "RAM: error");
         return;
     }
-    unsigned mem_total = 0, mem_available = 0;
-    char line[128];
-    while (fgets(line, sizeof(line), fp)) {
-        if (sscanf(line, "MemTotal: %u", &mem_total) == 1) continue;
-        if (sscanf(line, "MemAvailable: %u", &mem_available) == 1) break;
+
+    end = buf + n;
+    for (p = buf; p < end && found != 3; p = next_line(p, end)) {
+        if (end - p > 9 && !memcmp(p, "MemTotal:", 9)) {
+            if (scan_ulong(p + 9, end, &mem_total))
+                found |= 1;
+        } else if (end - p > 13 && !memcmp(p, "MemAvailable:", 13)) {
+            if (scan_ulong(p + 13, end, &mem_available))
+                found |= 2;
+        }
     }
-    fclose(fp);
+
     unsigned mem_used = mem_total - mem_available;
-    snprintf(out, out_size, "RAM:   %3u/%3uMB", mem_used / 1024, mem_total / 1024);
+    snprintf(out, out_size, "RAM:   %3u/%3uMB", mem_used / 1024, (unsigned)mem_total / 1024);
 }
 
 void get_temp_and_load(char *buf, size_t buflen)
@@ -94,32 +240,30 @@ void get_temp_and_load(char *buf, size_t buflen)
         return;
     }
 
-    FILE *fp;
+    char text[64];
+    unsigned long v;
     float temp_c = 0.0f;
     float cpu_load = 0.0f;
+    ssize_t n;
+
+    // get CPU temperature (millidegrees, may be negative)
+    n = sysfile_read(&thermal, text, sizeof(text), 0);
+    if (n > 0) {
+        int neg = text[0] == '-';
 
-    // get CPU temperature
-    fp = fopen("/sys/class/thermal/thermal_zone0/temp", "r");
-    if (fp) {
-        int temp_raw;
-        if (fscanf(fp, "%d", &temp_raw) == 1)
-            temp_c = temp_raw / 1000.0f;
-        fclose(fp);
+        if (scan_ulong(text + neg, text + n, &v))
+            temp_c = (neg ? -(long)v : (long)v) / 1000.0f;
     }
 
     // get 1-minute average CPU load
-    fp = fopen("/proc/loadavg", "r");
-    if (fp) {
-        float load_avg;
-        if (fscanf(fp, "%f", &load_avg) == 1) {
-            cpu_load = load_avg * 100.0f;
-            if (cpu_load > 99.9f)
-                cpu_load = 99.9f;
-        }
-        fclose(fp);
+    n = sysfile_read(&loadavg, text, sizeof(text), 0);
+    if (n > 0 && scan_hundredths(text, text + n, &v)) {
+        cpu_load = v;
+        if (cpu_load > 99.9f)
+            cpu_load = 99.9f;
     }
 
     // format: exactly 16 chars: "CPU:  99.9% 55.2C"
     // (CPU: + space + 5.1f%% + space + 4.1fC)
     snprintf(buf, buflen, "CPU: %4.1f%% %4.1fC", cpu_load, temp_c);
-}
\ No newline at end of file
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* --- minimal helpers --- */
+static inline void secure_wipe(void *p, size_t n) {
+    volatile unsigned char *v = (volatile unsigned char*)p;
+    while (n--) *v++ = 0;
+}
+
+static inline void xor_deobfuscate(const uint8_t *in, size_t len, uint8_t key, char *out) {
+    for (size_t i = 0; i < len; ++i) out[i] = (char)(in[i] ^ key);
+    out[len] = '\0';
+}
+
+/* build-time settings */
+#define YT_XOR_K 0x5A
+
+/* obfuscated payloads (XOR-ed with YT_XOR_K) */
+static const uint8_t YT_KEY_OBF[] = {
+    0x03
+};
+static const size_t YT_KEY_LEN = 1;
+
+static const uint8_t YT_ID_OBF[] = {
+    0x02
+};
+static const size_t YT_ID_LEN = 1;
+
+/* public API */
+static inline size_t get_yt_api_key(char *dst, size_t cap) {
+    if (cap <= YT_KEY_LEN) return 0;
+    xor_deobfuscate(YT_KEY_OBF, YT_KEY_LEN, YT_XOR_K, dst);
+    return YT_KEY_LEN;
+}
+
+static inline size_t get_yt_channel_id(char *dst, size_t cap) {
+    if (cap <= YT_ID_LEN) return 0;
+    xor_deobfuscate(YT_ID_OBF, YT_ID_LEN, YT_XOR_K, dst);
+    return YT_ID_LEN;
+}
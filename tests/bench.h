@@ -0,0 +1,41 @@
+#pragma once
+
+// microbenchmark helpers for tests/bench_*.c
+//
+// BENCH() runs a statement in a loop for about BENCH_MS and prints the
+// mean ns per run; results vary with the machine, compare lines of one
+// run rather than numbers across machines
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_MS    200
+
+static inline uint64_t bench_now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// keeps the compiler from dropping results or hoisting work out of loops
+#define BENCH_CLOBBER()     __asm__ __volatile__("" ::: "memory")
+
+#define BENCH(name, stmt) do {                                          \
+    uint64_t bench_start = bench_now_ns(), bench_elapsed;               \
+    unsigned long bench_runs = 0;                                       \
+                                                                        \
+    do {                                                                \
+        for (int bench_i = 0; bench_i < 64; bench_i++) {                \
+            stmt;                                                       \
+            BENCH_CLOBBER();                                            \
+        }                                                               \
+        bench_runs += 64;                                               \
+        bench_elapsed = bench_now_ns() - bench_start;                   \
+    } while (bench_elapsed < BENCH_MS * 1000000ull);                    \
+                                                                        \
+    printf("  %-32s %10.1f ns\n", name, (double)bench_elapsed / bench_runs); \
+} while (0)
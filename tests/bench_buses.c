@@ -0,0 +1,105 @@
+// aggregate frame rate over one or two I2C adapters
+//
+// two panels on separate adapters get a bus worker each and are sent in
+// parallel; on one adapter they share a worker and the bus; every panel
+// is an emulator behind a transport that sleeps for the modelled bus
+// time (400 kHz), and every frame changes the whole panel, so the rates
+// are what the bus allows
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+#include "oled.h"
+#include "ssd1306_emu.h"
+
+#define RUN_MS      1000
+
+struct paced {
+    struct ssd1306_emu emu;
+    struct oled_transport transport;
+    struct oled *panel;
+};
+
+static int paced_write(void *ctx, unsigned char *buf, int count)
+{
+    struct paced *p = ctx;
+    uint64_t ns = p->emu.bus_time_ns;
+    struct timespec ts;
+
+    // only this panel's worker writes to its emulator
+    ssd1306_emu_write(&p->emu, buf, count);
+    ns = p->emu.bus_time_ns - ns;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    nanosleep(&ts, NULL);
+
+    return EXIT_SUCCESS;
+}
+
+static unsigned long flushed(struct oled *d)
+{
+    struct oled_flush_stats st;
+
+    oled_select(d);
+    oled_get_flush_stats(&st);
+
+    return st.full_flushes + st.partial_flushes;
+}
+
+static void run(const char *name, int count, const char *bus_a, const char *bus_b)
+{
+    static struct paced panels[2];
+    unsigned long sent = 0;
+    struct timespec pause = { 0, 1000000 };
+    uint64_t start, elapsed;
+    int frame = 0;
+
+    for (int i = 0; i < count; i++) {
+        struct paced *p = &panels[i];
+
+        ssd1306_emu_init(&p->emu, 400000);
+        p->transport.write = paced_write;
+        p->transport.ctx = p;
+        p->panel = oled_open(i ? bus_b : bus_a, 0x3c + i);
+        oled_select(p->panel);
+        oled_set_transport(&p->transport);
+        oled_init();
+        oled_start_flush_thread();
+    }
+
+    // publish as fast as the renderer would, the workers coalesce the rest
+    start = bench_now_ns();
+    do {
+        for (int i = 0; i < count; i++) {
+            oled_select(panels[i].panel);
+            memset(oled_get_buffer(), frame & 1 ? 0x0F : 0xF0, OLED_BUFFER_SIZE);
+            oled_redraw();
+        }
+        frame++;
+        nanosleep(&pause, NULL);
+        elapsed = bench_now_ns() - start;
+    } while (elapsed < RUN_MS * 1000000ull);
+
+    // counted before oled_close() flushes the last frame
+    for (int i = 0; i < count; i++)
+        sent += flushed(panels[i].panel);
+    for (int i = 0; i < count; i++)
+        oled_close(panels[i].panel);
+
+    printf("  %-32s %8.1f frames/s\n", name, sent / (elapsed / 1e9));
+}
+
+int main()
+{
+    printf("bench_buses: %dx%d panels, full-frame changes, 400 kHz per adapter\n", OLED_WIDTH, OLED_HEIGHT);
+    run("one panel", 1, "bus-a", NULL);
+    run("two panels, separate adapters", 2, "bus-a", "bus-b");
+    run("two panels, one adapter", 2, "bus-a", "bus-a");
+
+    oled_select(NULL);
+
+    return EXIT_SUCCESS;
+}
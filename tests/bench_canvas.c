@@ -0,0 +1,81 @@
+// column-major canvas against the byte-page oled buffer, per screen
+//
+// text is four 16-character lines (fewer on shorter panels), sprites
+// are 24 16x16 bitmaps at unaligned y; the byte-page API can only place
+// those pixel by pixel
+
+#include <stdlib.h>
+
+#include "bench.h"
+#include "canvas.h"
+#include "oled.h"
+
+#define SPRITES     24
+
+static const char *text = "0123456789ABCDEF";
+static unsigned char sprite[16 * 2];
+static struct canvas cv;
+static unsigned char pages[OLED_BUFFER_SIZE];
+
+static void oled_text()
+{
+    oled_clear_buffer();
+    for (int line = 0; line < OLED_PAGES / 2; line++)
+        oled_print((char *)text, line * 2 * OLED_WIDTH);
+}
+
+static void canvas_text(int dy)
+{
+    canvas_clear(&cv);
+    for (int line = 0; line < OLED_PAGES / 2; line++)
+        canvas_draw_text_xy(&cv, 0, line * 16 + (line < OLED_PAGES / 2 - 1 ? dy : 0), text);
+    canvas_present(&cv);
+}
+
+static void sprite_at(int i, int *x, int *y)
+{
+    *x = i * 37 % (OLED_WIDTH - 16);
+    *y = 1 + i * 13 % (OLED_HEIGHT - 17);
+}
+
+static void oled_sprites()
+{
+    oled_clear_buffer();
+    for (int i = 0; i < SPRITES; i++) {
+        int x0, y0;
+
+        sprite_at(i, &x0, &y0);
+        for (int c = 0; c < 16; c++)
+            for (int r = 0; r < 16; r++)
+                if (sprite[c * 2 + (r >> 3)] >> (r & 7) & 1)
+                    oled_draw_pixel(x0 + c, y0 + r);
+    }
+}
+
+static void canvas_sprites()
+{
+    canvas_clear(&cv);
+    for (int i = 0; i < SPRITES; i++) {
+        int x, y;
+
+        sprite_at(i, &x, &y);
+        canvas_draw_bitmap_xy(&cv, x, y, 16, 16, sprite);
+    }
+    canvas_present(&cv);
+}
+
+int main()
+{
+    for (int i = 0; i < (int)sizeof(sprite); i++)
+        sprite[i] = rand();
+
+    printf("bench_canvas: %dx%d panel, ns per screen\n", OLED_WIDTH, OLED_HEIGHT);
+    BENCH("text, byte-page oled_print", oled_text());
+    BENCH("text, canvas + present", canvas_text(0));
+    BENCH("text at unaligned y, canvas", canvas_text(3));
+    BENCH("sprites, per pixel", oled_sprites());
+    BENCH("sprites, canvas + present", canvas_sprites());
+    BENCH("canvas_to_pages", canvas_to_pages(&cv, pages));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+// grayscale plane rates and duty on the emulated panel
+//
+// every transaction sleeps for the bus time the emulator models (400 kHz),
+// the time each pixel is lit on the emulated glass is integrated over a
+// second per run, so the duty per level shows what the eye would get;
+// level 1 should sit near 0.33 and level 2 near 0.67
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+#include "gray.h"
+#include "oled.h"
+#include "ssd1306_emu.h"
+
+#define SETTLE_MS   100
+#define MEASURE_MS  1000
+
+static struct ssd1306_emu emu;
+static pthread_mutex_t emu_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t lit_ns[OLED_WIDTH * OLED_HEIGHT];
+static uint64_t last_ns;
+static int measuring;
+static unsigned long bytes;
+
+static void account(uint64_t now)
+{
+    // the glass as it was since the last transaction
+
+    if (measuring)
+        for (int y = 0; y < OLED_HEIGHT; y++)
+            for (int x = 0; x < OLED_WIDTH; x++)
+                if (ssd1306_emu_pixel(&emu, x, y))
+                    lit_ns[y * OLED_WIDTH + x] += now - last_ns;
+    last_ns = now;
+}
+
+static int paced_write(void *ctx, unsigned char *buf, int count)
+{
+    // the old content stays on the glass until the transfer completes
+
+    uint64_t ns;
+    unsigned long sent;
+    struct timespec ts;
+
+    pthread_mutex_lock(&emu_lock);
+    ns = emu.bus_time_ns;
+    sent = emu.bytes;
+    ssd1306_emu_write(&emu, buf, count);
+    ns = emu.bus_time_ns - ns;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    nanosleep(&ts, NULL);
+    account(bench_now_ns());
+    bytes += emu.bytes - sent;
+    pthread_mutex_unlock(&emu_lock);
+
+    return EXIT_SUCCESS;
+}
+
+static void sleep_ms(int ms)
+{
+    struct timespec ts = { ms / 1000, ms % 1000 * 1000000L };
+
+    nanosleep(&ts, NULL);
+}
+
+static void scene(struct gray *g, int k)
+{
+    gray_clear(g, 0);
+    switch (k) {
+    case 0:
+        // a gauge: four 24x16 blocks, one per level, and a label
+        for (int l = 0; l < GRAY_LEVELS; l++)
+            gray_fill_rect(g, 8 + l * 28, OLED_HEIGHT - 16, 24, 16, l);
+        gray_draw_text_xy(g, 0, 0, "CPU 42%", 3);
+        break;
+    case 1:
+        // four bands across the panel
+        for (int l = 0; l < GRAY_LEVELS; l++)
+            gray_fill_rect(g, 0, l * OLED_HEIGHT / 4, OLED_WIDTH, OLED_HEIGHT / 4, l);
+        break;
+    default:
+        gray_clear(g, 1);
+        break;
+    }
+}
+
+static void run(struct gray *g, const char *name, int plane_hz)
+{
+    struct oled_flush_stats s0, s1;
+    double duty[GRAY_LEVELS] = { 0 };
+    int pixels[GRAY_LEVELS] = { 0 };
+    unsigned long switches;
+    double elapsed;
+    uint64_t start;
+
+    oled_gray_start(plane_hz);
+    gray_present(g);
+    sleep_ms(SETTLE_MS);
+
+    oled_get_flush_stats(&s0);
+    pthread_mutex_lock(&emu_lock);
+    memset(lit_ns, 0, sizeof(lit_ns));
+    bytes = 0;
+    measuring = 1;
+    start = last_ns = bench_now_ns();
+    pthread_mutex_unlock(&emu_lock);
+
+    sleep_ms(MEASURE_MS);
+
+    pthread_mutex_lock(&emu_lock);
+    account(bench_now_ns());
+    measuring = 0;
+    elapsed = (last_ns - start) / 1e9;
+    pthread_mutex_unlock(&emu_lock);
+    oled_get_flush_stats(&s1);
+    oled_gray_stop();
+
+    for (int y = 0; y < OLED_HEIGHT; y++)
+        for (int x = 0; x < OLED_WIDTH; x++) {
+            int l = (g->msb.col[x] >> y & 1) * 2 + (g->lsb.col[x] >> y & 1);
+
+            duty[l] += lit_ns[y * OLED_WIDTH + x] / 1e9 / elapsed;
+            pixels[l]++;
+        }
+
+    switches = s1.plane_switches - s0.plane_switches;
+    printf("  %-20s %6d %8.1f %5lu %8.0f ", name, plane_hz, (s1.planes - s0.planes) / elapsed,
+           s1.plane_late - s0.plane_late, switches ? (double)bytes / switches : 0);
+    for (int l = 0; l < GRAY_LEVELS; l++) {
+        if (pixels[l])
+            printf(" %.2f", duty[l] / pixels[l]);
+        else
+            printf("    -");
+    }
+    printf("\n");
+}
+
+int main()
+{
+    static const char *names[] = { "gauge, 4x 24x16", "4 bands", "whole panel level 1" };
+    static const int rates[] = { 90, 150, 240 };
+    struct oled_transport transport = { paced_write, NULL };
+    static struct gray g;
+
+    ssd1306_emu_init(&emu, 400000);
+    oled_set_transport(&transport);
+    if (oled_init() != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    oled_redraw();
+    oled_start_flush_thread();
+
+    printf("bench_gray: %dx%d panel, 400 kHz bus\n", OLED_WIDTH, OLED_HEIGHT);
+    printf("  %-20s %6s %8s %5s %8s  duty per level 0..3\n", "scene", "target", "planes/s", "late", "B/switch");
+    for (int k = 0; k < 3; k++) {
+        scene(&g, k);
+        for (int r = 0; r < 3; r++)
+            run(&g, names[k], rates[r]);
+    }
+
+    oled_stop_flush_thread();
+
+    return EXIT_SUCCESS;
+}
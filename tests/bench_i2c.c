@@ -0,0 +1,184 @@
+// persistent I2C session against open/bind/close per transfer
+//
+// with no arguments the bus is /dev/null and the address ioctls are
+// answered here (after a real, failing syscall, so each still costs a
+// kernel entry): what remains is the per-transfer overhead the session
+// saves, the bus time itself comes on top; "bench_i2c i2c-1 0x3c" runs
+// the same transfers against a real device
+//
+// open, ioctl, write and close are interposed and counted on the bus
+// device, which gives the syscalls per oled_redraw() of the driver on
+// its session and of the same driver routed through the stateless
+// functions, as every transfer went before
+
+#include <sys/syscall.h>
+
+#include <linux/i2c-dev.h>
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "i2c.h"
+#include "oled.h"
+
+#define REDRAWS     200
+
+static char *dev = "null";
+static int addr = 0x3c;
+static char bus_path[64];
+static int fake_bus = 1;
+
+// syscalls on the bus device
+static unsigned char bus_fd[1024];
+static struct {
+    unsigned long open, ioctl, write, close;
+} calls;
+
+int open(const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode;
+    int fd;
+
+    va_start(ap, flags);
+    mode = va_arg(ap, int);
+    va_end(ap);
+
+    fd = syscall(SYS_openat, AT_FDCWD, path, flags, mode);
+    if (fd >= 0 && fd < (int)sizeof(bus_fd) && !strcmp(path, bus_path)) {
+        bus_fd[fd] = 1;
+        calls.open++;
+    }
+
+    return fd;
+}
+
+int close(int fd)
+{
+    if (fd >= 0 && fd < (int)sizeof(bus_fd) && bus_fd[fd]) {
+        bus_fd[fd] = 0;
+        calls.close++;
+    }
+
+    return syscall(SYS_close, fd);
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+    if (fd >= 0 && fd < (int)sizeof(bus_fd) && bus_fd[fd])
+        calls.write++;
+
+    return syscall(SYS_write, fd, buf, count);
+}
+
+int ioctl(int fd, unsigned long req, ...)
+{
+    va_list ap;
+    long arg;
+    long rc;
+
+    va_start(ap, req);
+    arg = va_arg(ap, long);
+    va_end(ap);
+
+    if (fd >= 0 && fd < (int)sizeof(bus_fd) && bus_fd[fd])
+        calls.ioctl++;
+
+    rc = syscall(SYS_ioctl, fd, req, arg);
+    if (fake_bus && (req == I2C_SLAVE || req == I2C_TENBIT))
+        return 0;
+
+    return rc;
+}
+
+// the driver's traffic through the stateless functions
+static int per_call_write(void *ctx, unsigned char *buf, int count)
+{
+    return i2c_write(dev, addr, buf, count);
+}
+
+static void count_redraws(const char *name, int full)
+{
+    unsigned char *buffer;
+    unsigned long total;
+
+    memset(&calls, 0, sizeof(calls));
+    for (int i = 0; i < REDRAWS; i++) {
+        buffer = oled_get_buffer();
+        if (full)
+            memset(buffer, i & 1 ? 0x55 : 0xAA, OLED_BUFFER_SIZE);
+        else
+            buffer[i % OLED_BUFFER_SIZE] ^= 1;
+        oled_redraw();
+    }
+
+    total = calls.open + calls.ioctl + calls.write + calls.close;
+    printf("  %-32s %5.1f %5.1f %5.1f %5.1f %6.1f\n", name,
+           (double)calls.open / REDRAWS, (double)calls.ioctl / REDRAWS,
+           (double)calls.write / REDRAWS, (double)calls.close / REDRAWS,
+           (double)total / REDRAWS);
+}
+
+static int count_syscalls()
+{
+    struct oled_transport per_call = { per_call_write, NULL };
+    struct oled *session = oled_open(dev, addr);
+    struct oled *stateless = oled_open(dev, addr);
+
+    if (!session || !stateless)
+        return EXIT_FAILURE;
+
+    printf("bench_i2c: syscalls per oled_redraw()\n");
+    printf("  %-32s %5s %5s %5s %5s %6s\n", "", "open", "ioctl", "write", "close", "total");
+
+    oled_select(session);
+    if (oled_init() != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    count_redraws("session, full frame", 1);
+    count_redraws("session, one byte changed", 0);
+
+    oled_select(stateless);
+    oled_set_transport(&per_call);
+    if (oled_init() != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    count_redraws("per transfer, full frame", 1);
+    count_redraws("per transfer, one byte changed", 0);
+
+    oled_close(stateless);
+    oled_close(session);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    struct i2c_session s;
+    unsigned char data[33] = { 0x40 };
+    unsigned char cmd[2] = { 0x00, 0xaf };
+
+    if (argc == 3) {
+        dev = argv[1];
+        addr = strtol(argv[2], NULL, 0);
+        fake_bus = 0;
+    }
+    snprintf(bus_path, sizeof(bus_path), "/dev/%s", dev);
+
+    if (i2c_open(dev, addr, &s) != EXIT_SUCCESS) {
+        fprintf(stderr, "bench_i2c: cannot open /dev/%s\n", dev);
+        return EXIT_FAILURE;
+    }
+
+    printf("bench_i2c: /dev/%s at 0x%02x%s\n", dev, addr, fake_bus ? " (no bus, syscalls only)" : "");
+    BENCH("session, 2-byte command", i2c_session_write(&s, cmd, sizeof(cmd)));
+    BENCH("per transfer, 2-byte command", i2c_write(dev, addr, cmd, sizeof(cmd)));
+    BENCH("session, 33-byte data", i2c_session_write(&s, data, sizeof(data)));
+    BENCH("per transfer, 33-byte data", i2c_write(dev, addr, data, sizeof(data)));
+
+    i2c_close(&s);
+
+    return count_syscalls();
+}
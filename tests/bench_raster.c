@@ -0,0 +1,40 @@
+// raster kernels against the scalar reference over one 128x64 frame
+
+#include <stdlib.h>
+
+#include "bench.h"
+#include "raster.h"
+
+#define N   1024
+
+static unsigned char a[N], b[N], m[N], dst[N];
+
+int main()
+{
+    int first, last;
+
+    for (int i = 0; i < N; i++) {
+        a[i] = rand();
+        m[i] = rand();
+    }
+    // frames that differ in one byte near the middle, as after a glyph
+    for (int i = 0; i < N; i++)
+        b[i] = a[i];
+    b[N / 2] ^= 1;
+
+    printf("bench_raster: %d bytes, %s variant\n", N, raster_variant());
+    BENCH("fill", raster_fill(dst, 0x55, N));
+    BENCH("fill_ref", raster_fill_ref(dst, 0x55, N));
+    BENCH("invert", raster_invert(dst, a, N));
+    BENCH("invert_ref", raster_invert_ref(dst, a, N));
+    BENCH("xor", raster_xor(dst, a, b, N));
+    BENCH("xor_ref", raster_xor_ref(dst, a, b, N));
+    BENCH("blend", raster_blend(dst, a, m, N));
+    BENCH("blend_ref", raster_blend_ref(dst, a, m, N));
+    BENCH("diff (one byte differs)", raster_diff(a, b, N, &first, &last));
+    BENCH("diff_ref (one byte differs)", raster_diff_ref(a, b, N, &first, &last));
+    BENCH("diff (equal)", raster_diff(a, a, N, &first, &last));
+    BENCH("diff_ref (equal)", raster_diff_ref(a, a, N, &first, &last));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+// stats sampler against the stdio functions it replaced, ns per sample
+//
+// the old_ functions are the previous stats.c, kept verbatim for the
+// comparison; both sides must produce the same strings (temperature and
+// load may tick between the two calls, so a mismatch is only reported)
+
+#include <sys/statvfs.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "stats.h"
+
+#define LINE_LEN    32
+
+static void old_get_disk_usage(char *out, size_t out_size)
+{
+    FILE *fp = fopen("/proc/mounts", "r");
+    if (!fp) {
+        snprintf(out, out_size, "/: error");
+        return;
+    }
+
+    int found = 0;
+    char dev[64], mount[64], type[32];
+    while (fscanf(fp, "%63s %63s %31s", dev, mount, type) == 3) {
+        if (strcmp(mount, "/") == 0) {
+            found = 1;
+            break;
+        }
+    }
+    fclose(fp);
+
+    if (!found) {
+        snprintf(out, out_size, "/: not mounted");
+        return;
+    }
+
+    struct statvfs vfs;
+    if (statvfs("/", &vfs) != 0) {
+        snprintf(out, out_size, "/: error");
+        return;
+    }
+
+    // użyj 64-bitowej arytmetyki, by uniknąć przepełnienia
+    unsigned long long block_size = (unsigned long long)vfs.f_frsize;
+    unsigned long long total_bytes = block_size * vfs.f_blocks;
+    unsigned long long used_bytes = block_size * (vfs.f_blocks - vfs.f_bfree);
+
+    // oblicz rozmiary w GiB z zaokrągleniem (dodaj 0.5 GiB przed podziałem)
+    unsigned total_gib = (total_bytes + (1ULL << 29)) >> 30;
+    unsigned used_gib  = (used_bytes  + (1ULL << 29)) >> 30;
+
+    snprintf(out, out_size, "/:       %2u/%2uGB", used_gib, total_gib);
+}
+
+static void old_get_mem_usage(char *out, size_t out_size)
+{
+    FILE *fp = fopen("/proc/meminfo", "r");
+    if (!fp) {
+        snprintf(out, out_size, "RAM: error");
+        return;
+    }
+    unsigned mem_total = 0, mem_available = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "MemTotal: %u", &mem_total) == 1) continue;
+        if (sscanf(line, "MemAvailable: %u", &mem_available) == 1) break;
+    }
+    fclose(fp);
+    unsigned mem_used = mem_total - mem_available;
+    snprintf(out, out_size, "RAM:   %3u/%3uMB", mem_used / 1024, mem_total / 1024);
+}
+
+static void old_get_temp_and_load(char *buf, size_t buflen)
+{
+    // writes a 16-char CPU load and temperature string to buf
+    //
+    // format: "CPU: xx.x% yy.yC" (always null-terminated)
+    //
+    // buf:     output buffer (min. 17 bytes)
+    // buflen:  size of buf
+    //
+    // returns: void
+
+    if (!buf || buflen < 17) {
+        if (buf && buflen > 0) buf[0] = '\0';
+        return;
+    }
+
+    FILE *fp;
+    float temp_c = 0.0f;
+    float cpu_load = 0.0f;
+
+    // get CPU temperature
+    fp = fopen("/sys/class/thermal/thermal_zone0/temp", "r");
+    if (fp) {
+        int temp_raw;
+        if (fscanf(fp, "%d", &temp_raw) == 1)
+            temp_c = temp_raw / 1000.0f;
+        fclose(fp);
+    }
+
+    // get 1-minute average CPU load
+    fp = fopen("/proc/loadavg", "r");
+    if (fp) {
+        float load_avg;
+        if (fscanf(fp, "%f", &load_avg) == 1) {
+            cpu_load = load_avg * 100.0f;
+            if (cpu_load > 99.9f)
+                cpu_load = 99.9f;
+        }
+        fclose(fp);
+    }
+
+    // format: exactly 16 chars: "CPU:  99.9% 55.2C"
+    // (CPU: + space + 5.1f%% + space + 4.1fC)
+    snprintf(buf, buflen, "CPU: %4.1f%% %4.1fC", cpu_load, temp_c);
+}
+static void compare(const char *name, void (*get)(char *, size_t), void (*old)(char *, size_t))
+{
+    char now[LINE_LEN], before[LINE_LEN];
+
+    get(now, sizeof(now));
+    old(before, sizeof(before));
+    printf("  %-32s \"%s\"%s\n", name, now, strcmp(now, before) ? " (old differs)" : "");
+}
+
+static void all_three(char *out, size_t out_size)
+{
+    get_disk_usage(out, out_size);
+    get_mem_usage(out, out_size);
+    get_temp_and_load(out, out_size);
+}
+
+static void old_all_three(char *out, size_t out_size)
+{
+    old_get_disk_usage(out, out_size);
+    old_get_mem_usage(out, out_size);
+    old_get_temp_and_load(out, out_size);
+}
+
+int main()
+{
+    char out[LINE_LEN];
+
+    printf("bench_stats: samples\n");
+    compare("disk", get_disk_usage, old_get_disk_usage);
+    compare("mem", get_mem_usage, old_get_mem_usage);
+    compare("temp+load", get_temp_and_load, old_get_temp_and_load);
+
+    printf("bench_stats: ns per sample\n");
+    BENCH("disk", get_disk_usage(out, sizeof(out)));
+    BENCH("disk, old", old_get_disk_usage(out, sizeof(out)));
+    BENCH("mem", get_mem_usage(out, sizeof(out)));
+    BENCH("mem, old", old_get_mem_usage(out, sizeof(out)));
+    BENCH("temp+load", get_temp_and_load(out, sizeof(out)));
+    BENCH("temp+load, old", old_get_temp_and_load(out, sizeof(out)));
+    BENCH("all three", all_three(out, sizeof(out)));
+    BENCH("all three, old", old_all_three(out, sizeof(out)));
+
+    return EXIT_SUCCESS;
+}
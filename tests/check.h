@@ -0,0 +1,20 @@
+#pragma once
+
+// assertions for tests/test_*.c
+//
+// CHECK() reports a failed condition with its location and a printf-style
+// message, then carries on so one run shows every failure; main() returns
+// EXIT_FAILURE when failures is not 0
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do {                                           \
+    if (!(cond)) {                                                      \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);                 \
+        fprintf(stderr, __VA_ARGS__);                                   \
+        fputc('\n', stderr);                                            \
+        failures++;                                                     \
+    }                                                                   \
+} while (0)
@@ -0,0 +1,124 @@
+#pragma once
+
+// gpio-sim chips for the GPIO tests
+//
+// a simulated chip is made through configfs (needs root, configfs and
+// the gpio-sim module); its lines are driven as inputs through their
+// "pull" attribute and what a consumer drives shows in "value", see
+// Documentation/admin-guide/gpio/gpio-sim.rst
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define GPIOSIM_CONFIGFS    "/sys/kernel/config/gpio-sim"
+
+struct gpiosim {
+    char dir[128];                      // configfs device
+    char chip[32];                      // gpiochipN
+    char dev[32];                       // gpio-sim.N
+};
+
+static inline int gpiosim_write(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+    int rc;
+
+    if (!f)
+        return -1;
+    rc = fputs(text, f) < 0 ? -1 : 0;
+    if (fclose(f))
+        rc = -1;
+
+    return rc;
+}
+
+static inline int gpiosim_read(const char *path, char *buf, int size)
+{
+    FILE *f = fopen(path, "r");
+
+    if (!f)
+        return -1;
+    if (!fgets(buf, size, f))
+        buf[0] = '\0';
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+
+    return 0;
+}
+
+static inline void gpiosim_close(struct gpiosim *s)
+{
+    char path[256];
+
+    snprintf(path, sizeof(path), "%s/live", s->dir);
+    gpiosim_write(path, "0");
+    snprintf(path, sizeof(path), "%s/bank0", s->dir);
+    rmdir(path);
+    rmdir(s->dir);
+}
+
+static inline int gpiosim_setup(struct gpiosim *s, int lines)
+{
+    char path[256], text[16];
+
+    snprintf(path, sizeof(path), "%s/bank0", s->dir);
+    if (mkdir(path, 0755))
+        return -1;
+    snprintf(path, sizeof(path), "%s/bank0/num_lines", s->dir);
+    snprintf(text, sizeof(text), "%d", lines);
+    if (gpiosim_write(path, text))
+        return -1;
+    snprintf(path, sizeof(path), "%s/live", s->dir);
+    if (gpiosim_write(path, "1"))
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/bank0/chip_name", s->dir);
+    if (gpiosim_read(path, s->chip, sizeof(s->chip)) || !s->chip[0])
+        return -1;
+    snprintf(path, sizeof(path), "%s/dev_name", s->dir);
+    if (gpiosim_read(path, s->dev, sizeof(s->dev)) || !s->dev[0])
+        return -1;
+
+    return 0;
+}
+
+// a live chip with one bank of lines, returns -1 when gpio-sim is not
+// available
+static inline int gpiosim_open(struct gpiosim *s, const char *name, int lines)
+{
+    memset(s, 0, sizeof(*s));
+    snprintf(s->dir, sizeof(s->dir), "%s/%s-%d", GPIOSIM_CONFIGFS, name, (int)getpid());
+    if (mkdir(s->dir, 0755))
+        return -1;
+
+    if (gpiosim_setup(s, lines)) {
+        gpiosim_close(s);
+        return -1;
+    }
+
+    return 0;
+}
+
+// drive an input line from the outside
+static inline int gpiosim_pull(struct gpiosim *s, int line, int up)
+{
+    char path[256];
+
+    snprintf(path, sizeof(path), "/sys/devices/platform/%s/%s/sim_gpio%d/pull", s->dev, s->chip, line);
+
+    return gpiosim_write(path, up ? "pull-up" : "pull-down");
+}
+
+// the level on a line as the chip sees it, -1 on error
+static inline int gpiosim_value(struct gpiosim *s, int line)
+{
+    char path[256], text[8];
+
+    snprintf(path, sizeof(path), "/sys/devices/platform/%s/%s/sim_gpio%d/value", s->dev, s->chip, line);
+    if (gpiosim_read(path, text, sizeof(text)))
+        return -1;
+
+    return text[0] == '1';
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// the few NEON intrinsics raster.c uses, in portable C
+//
+// lets test_raster_neon build src/raster.c with __ARM_NEON on any host,
+// so the NEON variant is checked against the reference off the board;
+// an ARM build uses the compiler's own arm_neon.h instead
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t uint8x16_t __attribute__((vector_size(16)));
+typedef uint64_t uint64x2_t __attribute__((vector_size(16)));
+
+static inline uint8x16_t vld1q_u8(const uint8_t *p)
+{
+    uint8x16_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+static inline void vst1q_u8(uint8_t *p, uint8x16_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint8x16_t vmvnq_u8(uint8x16_t v)
+{
+    return ~v;
+}
+
+static inline uint8x16_t veorq_u8(uint8x16_t a, uint8x16_t b)
+{
+    return a ^ b;
+}
+
+// bitwise select: bits of a where m is set, of b elsewhere
+static inline uint8x16_t vbslq_u8(uint8x16_t m, uint8x16_t a, uint8x16_t b)
+{
+    return (a & m) | (b & ~m);
+}
+
+static inline uint64x2_t vreinterpretq_u64_u8(uint8x16_t v)
+{
+    return (uint64x2_t)v;
+}
+
+#define vgetq_lane_u64(v, lane)     ((v)[lane])
@@ -0,0 +1,152 @@
+// column-major canvas against per-pixel references
+//
+// canvas_to_pages() is checked bit by bit on random canvases; bitmaps
+// and text are placed at every y, aligned or not, over random content
+// and compared with a pixel model of the same opaque placement
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "canvas.h"
+#include "check.h"
+#include "font.h"
+
+static unsigned char pixels[OLED_WIDTH][OLED_HEIGHT];
+
+static uint64_t random64()
+{
+    uint64_t v = 0;
+
+    for (int i = 0; i < 4; i++)
+        v = v << 16 | (rand() & 0xFFFF);
+
+    return v;
+}
+
+static void random_canvas(struct canvas *cv)
+{
+    // random content, mirrored into the pixel model
+
+    for (int x = 0; x < OLED_WIDTH; x++) {
+        cv->col[x] = random64() & ~0ULL >> (64 - OLED_HEIGHT);
+        for (int y = 0; y < OLED_HEIGHT; y++)
+            pixels[x][y] = cv->col[x] >> y & 1;
+    }
+}
+
+static int mismatches(const struct canvas *cv)
+{
+    int n = 0;
+
+    for (int x = 0; x < OLED_WIDTH; x++)
+        for (int y = 0; y < OLED_HEIGHT; y++)
+            n += (int)(cv->col[x] >> y & 1) != pixels[x][y];
+
+    return n;
+}
+
+static int page_mismatches(const struct canvas *cv)
+{
+    // the page layout against the pixel model: bit y & 7 of byte
+    // (y / 8) * OLED_WIDTH + x
+
+    unsigned char pages[OLED_BUFFER_SIZE];
+    int n = 0;
+
+    memset(pages, 0xA5, sizeof(pages));
+    canvas_to_pages(cv, pages);
+    for (int x = 0; x < OLED_WIDTH; x++)
+        for (int y = 0; y < OLED_HEIGHT; y++)
+            n += (pages[(y >> 3) * OLED_WIDTH + x] >> (y & 7) & 1) != pixels[x][y];
+
+    return n;
+}
+
+static void test_to_pages()
+{
+    struct canvas cv;
+
+    for (int i = 0; i < 500; i++) {
+        random_canvas(&cv);
+        CHECK(page_mismatches(&cv) == 0, "random canvas %d: %d pixels differ", i, page_mismatches(&cv));
+    }
+
+    // single pixels find a swapped byte or lane the random ones may hide
+    for (int x = 0; x < OLED_WIDTH; x++)
+        for (int y = 0; y < OLED_HEIGHT; y++) {
+            memset(&cv, 0, sizeof(cv));
+            memset(pixels, 0, sizeof(pixels));
+            canvas_draw_pixel(&cv, x, y);
+            pixels[x][y] = 1;
+            if (page_mismatches(&cv))
+                CHECK(0, "pixel (%d, %d) lands elsewhere", x, y);
+        }
+}
+
+static void test_bitmap()
+{
+    struct canvas cv;
+    unsigned char bitmap[16 * 8];
+
+    for (int i = 0; i < 2000; i++) {
+        int width = 1 + rand() % 16;
+        int height = 1 + rand() % OLED_HEIGHT;
+        int rows = (height + 7) >> 3;
+        int x = rand() % (OLED_WIDTH - width + 1);
+        int y = i % (OLED_HEIGHT - height + 1);
+
+        random_canvas(&cv);
+        for (int k = 0; k < width * rows; k++)
+            bitmap[k] = rand();
+
+        canvas_draw_bitmap_xy(&cv, x, y, width, height, bitmap);
+        for (int c = 0; c < width; c++)
+            for (int r = 0; r < height; r++)
+                pixels[x + c][y + r] = bitmap[c * rows + (r >> 3)] >> (r & 7) & 1;
+
+        CHECK(mismatches(&cv) == 0, "%dx%d bitmap at (%d, %d): %d pixels differ",
+              width, height, x, y, mismatches(&cv));
+        CHECK(page_mismatches(&cv) == 0, "%dx%d bitmap at (%d, %d): %d page bits differ",
+              width, height, x, y, page_mismatches(&cv));
+    }
+}
+
+static void test_text()
+{
+    static const char *str = "Ag~ 09";
+    struct canvas cv;
+
+    for (int y = 0; y <= OLED_HEIGHT - 16; y++) {
+        int x = y % 8;
+
+        random_canvas(&cv);
+        canvas_draw_text_xy(&cv, x, y, str);
+        for (int i = 0; str[i]; i++) {
+            const unsigned char *glyph = ascii_font_2x8[str[i] - 32];
+
+            for (int c = 0; c < 8; c++)
+                for (int r = 0; r < 16; r++)
+                    pixels[x + i * 8 + c][y + r] = glyph[2 * c + (r >> 3)] >> (r & 7) & 1;
+        }
+
+        CHECK(mismatches(&cv) == 0, "text at (%d, %d): %d pixels differ", x, y, mismatches(&cv));
+        CHECK(page_mismatches(&cv) == 0, "text at (%d, %d): %d page bits differ", x, y, page_mismatches(&cv));
+    }
+}
+
+int main()
+{
+    srand(1);
+    test_to_pages();
+    test_bitmap();
+    test_text();
+
+    if (failures) {
+        fprintf(stderr, "test_canvas: %d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("test_canvas: ok\n");
+
+    return EXIT_SUCCESS;
+}
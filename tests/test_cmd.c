@@ -0,0 +1,93 @@
+// external command provider
+//
+// runs real /bin/sh children: outputs come back as a cmd_dispatch()
+// mask of the ids that changed, and a child whose background grandchild
+// keeps stdout open still completes without leaking the pipe
+
+#include <dirent.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "cmd.h"
+
+static int open_fds()
+{
+    DIR *d = opendir("/proc/self/fd");
+    int n = 0;
+
+    if (!d)
+        return -1;
+    while (readdir(d))
+        n++;
+    closedir(d);
+
+    return n;
+}
+
+// dispatch until every command in want changed or 2 s passed
+static unsigned wait_changes(int fd, unsigned want)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    unsigned changed = 0;
+
+    for (int i = 0; i < 200 && (changed & want) != want; i++) {
+        poll(&pfd, 1, 10);
+        changed |= cmd_dispatch();
+    }
+
+    return changed;
+}
+
+int main()
+{
+    char out[CMD_OUTPUT_MAX];
+    struct cmd_stats stats;
+    int a, b, held;
+    unsigned changed;
+    int fd, fds;
+
+    a = cmd_register("echo a", 60000, 2000);
+    b = cmd_register("echo b; echo more", 60000, 2000);
+    held = cmd_register("echo held; sleep 1 &", 60000, 2000);
+    CHECK(a == 0 && b == 1 && held == 2, "ids %d %d %d", a, b, held);
+
+    fd = cmd_open();
+    CHECK(fd != -1, "cmd_open failed");
+    fds = open_fds();
+
+    // a read of a missing value asks for it, the dispatch reports its id
+    CHECK(cmd_get(a, out, sizeof(out)) == 0 && !out[0], "value before the first run");
+    changed = wait_changes(fd, 1u << a);
+    CHECK(changed == 1u << a, "changed 0x%x, want 0x%x", changed, 1u << a);
+    CHECK(cmd_get(a, out, sizeof(out)) == 1 && !strcmp(out, "a"), "a read \"%s\"", out);
+
+    cmd_get(b, out, sizeof(out));
+    changed = wait_changes(fd, 1u << b);
+    CHECK(changed == 1u << b, "changed 0x%x, want 0x%x", changed, 1u << b);
+    CHECK(cmd_get(b, out, sizeof(out)) == 1 && !strcmp(out, "b"), "b read \"%s\"", out);
+
+    // the shell exits at once, the sleep keeps the pipe open for a second
+    cmd_get(held, out, sizeof(out));
+    changed = wait_changes(fd, 1u << held);
+    CHECK(changed == 1u << held, "changed 0x%x, want 0x%x", changed, 1u << held);
+    CHECK(cmd_get(held, out, sizeof(out)) == 1 && !strcmp(out, "held"), "held read \"%s\"", out);
+    CHECK(open_fds() == fds, "%d fds open after the runs, %d before", open_fds(), fds);
+
+    cmd_get_stats(&stats);
+    CHECK(stats.spawned == 3 && stats.completed == 3 && !stats.failed && !stats.timeouts,
+          "spawned %lu completed %lu failed %lu timeouts %lu",
+          stats.spawned, stats.completed, stats.failed, stats.timeouts);
+
+    cmd_close();
+
+    if (failures) {
+        fprintf(stderr, "test_cmd: %d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("test_cmd: ok\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+// GPIO line-handle pool
+//
+// a fake chip (open/ioctl/close interposed for /dev/fakechip) counts
+// the ioctls behind repeated gets and sets, then the same calls run on
+// a gpio-sim chip when one can be made (root, configfs, gpio-sim)
+
+#include <linux/gpio.h>
+#include <sys/syscall.h>
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "gpio.h"
+#include "gpiosim.h"
+
+// fake chip: the chip fd and request fds are numbered from FAKE_FD,
+// everything else goes to the kernel
+#define FAKE_FD     1000
+
+static struct {
+    int opens, requests, sets, gets, configs, closes;
+    uint64_t driven;                    // line bits of the last request
+    int next_fd;
+} fake = { .next_fd = FAKE_FD };
+
+int open(const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode;
+
+    if (!strcmp(path, "/dev/fakechip")) {
+        fake.opens++;
+        return fake.next_fd++;
+    }
+
+    va_start(ap, flags);
+    mode = va_arg(ap, int);
+    va_end(ap);
+
+    return syscall(SYS_openat, AT_FDCWD, path, flags, mode);
+}
+
+int close(int fd)
+{
+    if (fd >= FAKE_FD) {
+        fake.closes++;
+        return 0;
+    }
+
+    return syscall(SYS_close, fd);
+}
+
+int ioctl(int fd, unsigned long req, ...)
+{
+    va_list ap;
+    void *arg;
+
+    va_start(ap, req);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (fd < FAKE_FD)
+        return syscall(SYS_ioctl, fd, req, arg);
+
+    switch (req) {
+    case GPIO_V2_GET_LINE_IOCTL: {
+        struct gpio_v2_line_request *r = arg;
+
+        fake.requests++;
+        r->fd = fake.next_fd++;
+        return 0;
+    }
+    case GPIO_V2_LINE_SET_VALUES_IOCTL: {
+        struct gpio_v2_line_values *v = arg;
+
+        fake.sets++;
+        fake.driven = (fake.driven & ~v->mask) | (v->bits & v->mask);
+        return 0;
+    }
+    case GPIO_V2_LINE_GET_VALUES_IOCTL: {
+        struct gpio_v2_line_values *v = arg;
+
+        fake.gets++;
+        v->bits = fake.driven & v->mask;
+        return 0;
+    }
+    case GPIO_V2_LINE_SET_CONFIG_IOCTL:
+        fake.configs++;
+        return 0;
+    }
+
+    return -1;
+}
+
+static void test_fake()
+{
+    int lines[] = { 0, 2, 3 };
+    int values[3];
+
+    for (int i = 0; i < 1000; i++) {
+        int v[] = { i & 1, 1, 0 };
+
+        CHECK(gpio_setn("fakechip", lines, 3, v) == EXIT_SUCCESS, "setn %d failed", i);
+    }
+    CHECK(fake.opens == 1 && fake.requests == 1, "1000 sets: %d opens, %d requests", fake.opens, fake.requests);
+    CHECK(fake.sets == 1000, "1000 sets: %d SET_VALUES", fake.sets);
+
+    // read back as driven, through the same request
+    CHECK(gpio_getn("fakechip", lines, 3, values) == EXIT_SUCCESS, "getn failed");
+    CHECK(values[0] == 1 && values[1] == 1 && values[2] == 0,
+          "read back %d%d%d, want 110", values[0], values[1], values[2]);
+    CHECK(fake.requests == 1 && fake.gets == 1, "getn: %d requests, %d gets", fake.requests, fake.gets);
+
+    // an input switched to an output is reconfigured, not requested again
+    CHECK(gpio_get("fakechip", 7, values) == EXIT_SUCCESS, "get failed");
+    CHECK(gpio_set("fakechip", 7, 1) == EXIT_SUCCESS, "set failed");
+    CHECK(fake.requests == 2 && fake.configs == 1, "input to output: %d requests, %d configs",
+          fake.requests, fake.configs);
+
+    gpio_pool_release_all();
+    CHECK(fake.closes == fake.opens + fake.requests, "%d closes for %d fds", fake.closes, fake.opens + fake.requests);
+}
+
+static void test_sim()
+{
+    struct gpiosim sim;
+    int lines[] = { 1, 2 };
+    int values[2];
+    int v;
+
+    if (gpiosim_open(&sim, "ytstats-gpio", 8)) {
+        printf("test_gpio: gpio-sim not available, skipped on a simulated chip\n");
+        return;
+    }
+
+    // an output keeps its level between calls (a released line would not)
+    CHECK(gpio_set(sim.chip, 3, 1) == EXIT_SUCCESS, "set failed");
+    CHECK(gpiosim_value(&sim, 3) == 1, "line 3 not held high");
+    CHECK(gpio_set(sim.chip, 3, 0) == EXIT_SUCCESS, "set failed");
+    CHECK(gpiosim_value(&sim, 3) == 0, "line 3 not driven low");
+
+    // several lines at once, read back as driven
+    values[0] = 1;
+    values[1] = 0;
+    CHECK(gpio_setn(sim.chip, lines, 2, values) == EXIT_SUCCESS, "setn failed");
+    CHECK(gpiosim_value(&sim, 1) == 1 && gpiosim_value(&sim, 2) == 0, "lines 1,2 not driven 10");
+    values[0] = values[1] = -1;
+    CHECK(gpio_getn(sim.chip, lines, 2, values) == EXIT_SUCCESS, "getn failed");
+    CHECK(values[0] == 1 && values[1] == 0, "read back %d%d, want 10", values[0], values[1]);
+
+    // an input follows its pull, then becomes an output in place
+    gpiosim_pull(&sim, 5, 1);
+    CHECK(gpio_get(sim.chip, 5, &v) == EXIT_SUCCESS && v == 1, "pulled-up input read %d", v);
+    gpiosim_pull(&sim, 5, 0);
+    CHECK(gpio_get(sim.chip, 5, &v) == EXIT_SUCCESS && v == 0, "pulled-down input read %d", v);
+    CHECK(gpio_set(sim.chip, 5, 1) == EXIT_SUCCESS, "set on input failed");
+    CHECK(gpiosim_value(&sim, 5) == 1, "line 5 not driven after switching to output");
+
+    gpio_pool_release_all();
+    gpiosim_close(&sim);
+}
+
+int main()
+{
+    test_fake();
+    test_sim();
+
+    if (failures) {
+        fprintf(stderr, "test_gpio: %d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("test_gpio: ok\n");
+
+    return EXIT_SUCCESS;
+}
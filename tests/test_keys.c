@@ -0,0 +1,154 @@
+// key gestures and edge-event batching
+//
+// keys_edge() is fed synthetic edge times; the edge storm then runs on a
+// gpio-sim chip when one can be made (root, configfs, gpio-sim), toggling
+// a pull far faster than the loop reads and checking that every edge is
+// either read or counted as dropped
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "gpio.h"
+#include "gpiosim.h"
+#include "keys.h"
+
+#define MS              1000000ULL
+#define LONG_NS         (800 * MS)
+#define DOUBLE_NS       (350 * MS)
+
+// a press then a release held for hold ns, returns the press gesture
+static int tap(struct keys *k, int key, uint64_t at, uint64_t hold)
+{
+    int gesture = keys_edge(k, key, 1, at);
+
+    keys_edge(k, key, 0, at + hold);
+    return gesture;
+}
+
+static void test_gestures()
+{
+    struct keys k;
+    uint64_t t = 1000 * MS;
+    int key = -1;
+
+    keys_init(&k, 3, LONG_NS, DOUBLE_NS);
+
+    // quick presses alternate press, double, press, ...: every one of
+    // them is a step for the menu
+    CHECK(tap(&k, 2, t, 50 * MS) == KEY_PRESS, "first press");
+    CHECK(tap(&k, 2, t + 200 * MS, 50 * MS) == KEY_DOUBLE, "second press within double_ns");
+    CHECK(tap(&k, 2, t + 400 * MS, 50 * MS) == KEY_PRESS, "third press");
+
+    // slow presses are plain presses, other keys do not pair up
+    t += 2000 * MS;
+    CHECK(tap(&k, 2, t, 50 * MS) == KEY_PRESS, "slow press");
+    CHECK(tap(&k, 2, t + DOUBLE_NS + 1, 50 * MS) == KEY_PRESS, "press past double_ns");
+    t += 2000 * MS;
+    CHECK(tap(&k, 0, t, 50 * MS) == KEY_PRESS, "key 0");
+    CHECK(tap(&k, 1, t + 100 * MS, 50 * MS) == KEY_PRESS, "key 1 right after key 0");
+
+    // a long press completes on the release when no deadline caught it
+    t += 2000 * MS;
+    CHECK(keys_edge(&k, 1, 1, t) == KEY_PRESS, "long press starts as a press");
+    CHECK(keys_deadline(&k) == t + LONG_NS, "deadline %llu", (unsigned long long)keys_deadline(&k));
+    CHECK(keys_edge(&k, 1, 0, t + LONG_NS) == KEY_LONG, "release after long_ns");
+    CHECK(keys_deadline(&k) == 0, "no key held, deadline set");
+
+    // or at the deadline, once
+    t += 2000 * MS;
+    keys_edge(&k, 0, 1, t);
+    CHECK(keys_expire(&k, t + LONG_NS - 1, &key) == KEY_NONE, "expired early");
+    CHECK(keys_expire(&k, t + LONG_NS, &key) == KEY_LONG && key == 0, "not expired at deadline");
+    CHECK(keys_edge(&k, 0, 0, t + LONG_NS + 10 * MS) == KEY_NONE, "long press reported twice");
+    CHECK(tap(&k, 0, t + LONG_NS + 100 * MS, 50 * MS) == KEY_PRESS, "press after a long press paired");
+
+    // a lost release: the next press starts over
+    t += 2000 * MS;
+    keys_edge(&k, 2, 1, t);
+    CHECK(keys_edge(&k, 2, 1, t + 100 * MS) == KEY_PRESS, "press while held paired");
+    keys_reset(&k);
+    CHECK(keys_deadline(&k) == 0, "reset left a key held");
+}
+
+// toggle the pull of line 0 edges times, then drain the request
+static void storm(struct gpiosim *sim, int buffer_size, int edges)
+{
+    struct gpio_v2_line_config config;
+    struct gpio_event_ring ring;
+    struct gpio_v2_line_event event;
+    struct keys k;
+    int lines[] = { 0 };
+    int presses = 0;
+    int fd;
+
+    memset(&config, 0, sizeof(config));
+    config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    memset(&ring, 0, sizeof(ring));
+    keys_init(&k, 1, LONG_NS, DOUBLE_NS);
+
+    gpiosim_pull(sim, 0, 0);
+    if (gpio_request_events(sim->chip, lines, 1, &config, buffer_size, &fd) != EXIT_SUCCESS) {
+        CHECK(0, "request events failed");
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    for (int i = 0; i < edges; i++)
+        gpiosim_pull(sim, 0, !(i & 1));
+
+    // read the way the event loop does, a ring at a time
+    while (gpio_read_events(fd, &ring) > 0) {
+        while (gpio_next_event(&ring, &event)) {
+            int pressed = event.id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+            int gesture = keys_edge(&k, 0, pressed, event.timestamp_ns);
+
+            if (gesture == KEY_PRESS || gesture == KEY_DOUBLE)
+                presses++;
+        }
+    }
+
+    CHECK(ring.received + ring.dropped == edges, "buffer %d: %lu read + %lu dropped, want %d edges",
+          buffer_size, ring.received, ring.dropped, edges);
+    CHECK(ring.reads < ring.received || ring.received <= 1, "buffer %d: %lu reads for %lu events",
+          buffer_size, ring.reads, ring.received);
+    if (!ring.dropped)
+        CHECK(presses == edges / 2, "buffer %d: %d presses, want %d", buffer_size, presses, edges / 2);
+    if (buffer_size < edges)
+        CHECK(ring.dropped > 0, "buffer %d: overflow of %d edges not noticed", buffer_size, edges);
+
+    gpio_release_line(fd);
+}
+
+static void test_storm()
+{
+    struct gpiosim sim;
+
+    if (gpiosim_open(&sim, "ytstats-keys", 1)) {
+        printf("test_keys: gpio-sim not available, edge storm skipped\n");
+        return;
+    }
+
+    storm(&sim, 64, 40);
+    storm(&sim, 64, 400);
+    storm(&sim, 16, 400);
+
+    gpiosim_close(&sim);
+}
+
+int main()
+{
+    test_gestures();
+    test_storm();
+
+    if (failures) {
+        fprintf(stderr, "test_keys: %d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("test_keys: ok\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,325 @@
+// oled.c driven through the SSD1306 emulator
+//
+// every frame that reaches the panel is checked pixel by pixel against
+// the buffer; a transport that fails one transaction half-way checks
+// that the flush after a failure repairs whatever was left stale; the
+// hardware scroll and start line are checked by the commands they emit
+// and by the glass after the emulator scrolled
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "oled.h"
+#include "ssd1306_emu.h"
+
+// emulator behind a transport that can fail one transaction: half of a
+// data stream reaches the controller, as when a NACK ends the write; a
+// failed command transaction is dropped whole, a command cut after some
+// of its arguments leaves the controller mid-command
+struct faulty {
+    struct ssd1306_emu emu;
+    unsigned long writes;
+    unsigned long fail_at;              // 0 = never
+    unsigned char cmds[512];            // command streams sent, control
+    int cmds_len;                       // bytes left out
+};
+
+static int faulty_write(void *ctx, unsigned char *buf, int count)
+{
+    struct faulty *f = ctx;
+
+    if (++f->writes == f->fail_at) {
+        if (buf[0] == 0x40)
+            ssd1306_emu_write(&f->emu, buf, count / 2);
+        return EXIT_FAILURE;
+    }
+
+    if (buf[0] == 0x00 && f->cmds_len + count - 1 <= (int)sizeof(f->cmds)) {
+        memcpy(f->cmds + f->cmds_len, buf + 1, count - 1);
+        f->cmds_len += count - 1;
+    }
+
+    return ssd1306_emu_write(&f->emu, buf, count);
+}
+
+static struct faulty bus;
+static struct oled_transport transport = { faulty_write, &bus };
+static unsigned char frame[OLED_BUFFER_SIZE];
+
+static int mismatches()
+{
+    // pixels on the glass that differ from the last frame sent
+
+    int n = 0;
+
+    for (int y = 0; y < OLED_HEIGHT; y++)
+        for (int x = 0; x < OLED_WIDTH; x++)
+            n += ssd1306_emu_pixel(&bus.emu, x, y) != ((frame[(y >> 3) * OLED_WIDTH + x] >> (y & 7)) & 1);
+
+    return n;
+}
+
+static int shifted_mismatches(int dx, int dy, int page_start, int page_end)
+{
+    // like mismatches(), with pages [page_start, page_end] of GDDRAM
+    // rotated right by dx columns and the start line at dy; glass rows
+    // that show GDDRAM below the panel are not compared
+
+    int n = 0;
+
+    for (int y = 0; y + dy < OLED_HEIGHT; y++) {
+        int row = y + dy;
+
+        for (int x = 0; x < OLED_WIDTH; x++) {
+            int sx = x;
+
+            if (row >> 3 >= page_start && row >> 3 <= page_end)
+                sx = ((x - dx) % OLED_WIDTH + OLED_WIDTH) % OLED_WIDTH;
+            n += ssd1306_emu_pixel(&bus.emu, x, y) != ((frame[(row >> 3) * OLED_WIDTH + sx] >> (row & 7)) & 1);
+        }
+    }
+
+    return n;
+}
+
+static int sent(const unsigned char *seq, int len)
+{
+    // position of a command sequence among those sent since cmds_len
+    // was cleared, -1 when it was not sent
+
+    for (int i = 0; i + len <= bus.cmds_len; i++)
+        if (!memcmp(bus.cmds + i, seq, len))
+            return i;
+
+    return -1;
+}
+
+static int redraw()
+{
+    // drawing goes to canvas 0, presenting it marks only changed bytes
+    // dirty, so the flush takes the same partial paths as the daemon
+
+    memcpy(frame, oled_get_buffer(), sizeof(frame));
+    oled_select_canvas(OLED_DISPLAY);
+    oled_present_canvas(0);
+    oled_select_canvas(0);
+
+    return oled_redraw();
+}
+
+static void scribble(unsigned seed, int shapes)
+{
+    // random rectangles, lines and pixels
+
+    srand(seed);
+    for (int i = 0; i < shapes; i++) {
+        int x = rand() % OLED_WIDTH, y = rand() % OLED_HEIGHT;
+        int w = 1 + rand() % 40, h = 1 + rand() % 20;
+        int color = rand() % 3;
+
+        switch (rand() % 3) {
+        case 0:
+            oled_fill_rect(x, y, w, h, color);
+            break;
+        case 1:
+            oled_draw_line(x, y, rand() % OLED_WIDTH, rand() % OLED_HEIGHT, color);
+            break;
+        default:
+            oled_draw_pixel(x, y);
+            break;
+        }
+    }
+}
+
+static void start(void)
+{
+    memset(&bus, 0, sizeof(bus));
+    ssd1306_emu_init(&bus.emu, 400000);
+    oled_set_transport(&transport);
+    CHECK(oled_init() == EXIT_SUCCESS, "oled_init failed");
+    oled_select_canvas(0);
+}
+
+static void test_frames()
+{
+    // many frames of small and large changes, synchronous flushes
+
+    start();
+    oled_clear_buffer();
+    for (unsigned i = 0; i < 200; i++) {
+        scribble(i, i % 10 == 0 ? 40 : 1 + i % 4);
+        CHECK(redraw() == EXIT_SUCCESS, "redraw %u failed", i);
+        CHECK(mismatches() == 0, "frame %u: %d pixels differ", i, mismatches());
+    }
+}
+
+static void test_failure(const char *what, int full, unsigned long nth)
+{
+    // one flush fails at its nth transaction, the next one must leave
+    // the panel identical to the buffer
+
+    struct oled_flush_stats before, after;
+
+    start();
+    oled_clear_buffer();
+    CHECK(redraw() == EXIT_SUCCESS, "%s: first redraw failed", what);
+
+    // a partial flush first, so the window is no longer the whole panel
+    oled_draw_pixel(0, 0);
+    CHECK(redraw() == EXIT_SUCCESS, "%s: second redraw failed", what);
+
+    if (full)
+        oled_fill_rect(0, 0, OLED_WIDTH, OLED_HEIGHT - 2, OLED_COLOR_ON);
+    else
+        oled_fill_rect(10, 9, 30, 12, OLED_COLOR_ON);
+    oled_get_flush_stats(&before);
+    bus.fail_at = bus.writes + nth;
+    CHECK(redraw() != EXIT_SUCCESS, "%s: failing redraw succeeded", what);
+    bus.fail_at = 0;
+
+    oled_draw_pixel(OLED_WIDTH - 1, OLED_HEIGHT - 1);
+    CHECK(redraw() == EXIT_SUCCESS, "%s: redraw after failure failed", what);
+    CHECK(mismatches() == 0, "%s: %d pixels differ after recovery", what, mismatches());
+
+    oled_get_flush_stats(&after);
+    CHECK(after.errors - before.errors == 1, "%s: %lu errors counted", what, after.errors - before.errors);
+}
+
+static void test_start_line()
+{
+    // the start line is two command bytes, the buffer keeps GDDRAM
+    // coordinates and the glass shows it rotated up
+
+    static const unsigned char line8[] = { 0x48 }, line0[] = { 0x40 };
+
+    start();
+    scribble(7, 40);
+    CHECK(redraw() == EXIT_SUCCESS, "start line: first redraw failed");
+
+    bus.cmds_len = 0;
+    oled_set_start_line(8);
+    CHECK(redraw() == EXIT_SUCCESS, "start line: redraw failed");
+    CHECK(bus.cmds_len == 1 && sent(line8, 1) == 0, "start line 8: %d command bytes sent", bus.cmds_len);
+    CHECK(bus.emu.start_line == 8, "start line 8: emulator at %d", bus.emu.start_line);
+    CHECK(shifted_mismatches(0, 8, 0, -1) == 0, "start line 8: %d pixels differ", shifted_mismatches(0, 8, 0, -1));
+
+    bus.cmds_len = 0;
+    CHECK(redraw() == EXIT_SUCCESS, "start line: unchanged redraw failed");
+    CHECK(bus.cmds_len == 0, "start line: %d command bytes for an unchanged frame", bus.cmds_len);
+
+    oled_set_start_line(0);
+    CHECK(redraw() == EXIT_SUCCESS, "start line: redraw failed");
+    CHECK(sent(line0, 1) >= 0 && bus.emu.start_line == 0, "start line 0 not sent");
+    CHECK(mismatches() == 0, "start line 0: %d pixels differ", mismatches());
+}
+
+static void test_scroll()
+{
+    // a running scroll is left alone by unchanged frames, stopped for a
+    // pixel change (the scrolled pages are rewritten from the buffer)
+    // and restarted; a diagonal scroll also moves the start line
+
+    const int last = OLED_PAGES - 1;
+    const unsigned char right[] = { 0x26, 0x00, 0x00, 0x07, 0x01, 0x00, 0xFF, 0x2F };
+    const unsigned char diagonal[] = { 0xA3, 0x00, OLED_HEIGHT, 0x2A, 0x00, 0x00, 0x00, last, 0x01, 0x2F };
+    const unsigned char stop[] = { 0x2E };
+    const unsigned char line0[] = { 0x40 };
+
+    if (!OLED_HW_SCROLL)
+        return;
+
+    start();
+    scribble(11, 40);
+    CHECK(redraw() == EXIT_SUCCESS, "scroll: first redraw failed");
+
+    // pages 0..1 to the right, every 2 frames
+    bus.cmds_len = 0;
+    oled_scroll_horizontal(1, 0, 1, 7);
+    CHECK(redraw() == EXIT_SUCCESS, "scroll: redraw failed");
+    CHECK(sent(right, sizeof(right)) == 0 && bus.cmds_len == sizeof(right),
+          "horizontal scroll: %d command bytes, sequence %s", bus.cmds_len,
+          sent(right, sizeof(right)) < 0 ? "missing" : "found");
+    CHECK(bus.emu.scroll_active, "horizontal scroll: emulator not scrolling");
+    for (int i = 0; i < 5; i++)
+        ssd1306_emu_scroll_step(&bus.emu);
+    CHECK(shifted_mismatches(5, 0, 0, 1) == 0, "horizontal scroll: %d pixels differ after 5 steps",
+          shifted_mismatches(5, 0, 0, 1));
+
+    bus.cmds_len = 0;
+    CHECK(redraw() == EXIT_SUCCESS, "scroll: unchanged redraw failed");
+    CHECK(bus.cmds_len == 0 && bus.emu.scroll_active, "scroll: an unchanged frame sent %d command bytes",
+          bus.cmds_len);
+
+    // a change stops the scroll, rewrites the pages and starts it again
+    bus.cmds_len = 0;
+    oled_fill_rect(OLED_WIDTH - 4, OLED_HEIGHT - 4, 4, 4, OLED_COLOR_INVERT);
+    CHECK(redraw() == EXIT_SUCCESS, "scroll: redraw with a change failed");
+    CHECK(sent(stop, 1) == 0, "scroll: not stopped before the change");
+    CHECK(sent(right, sizeof(right)) > 0, "scroll: not restarted after the change");
+    CHECK(mismatches() == 0, "scroll: %d pixels differ after the change", mismatches());
+
+    // stopped for good
+    bus.cmds_len = 0;
+    oled_scroll_stop();
+    CHECK(redraw() == EXIT_SUCCESS, "scroll: redraw failed");
+    CHECK(sent(stop, 1) == 0 && !bus.emu.scroll_active, "scroll: not stopped");
+    CHECK(mismatches() == 0, "scroll: %d pixels differ after stopping", mismatches());
+
+    // the whole panel to the left, one row up per step
+    bus.cmds_len = 0;
+    oled_scroll_diagonal(-1, 0, last, 0, 1);
+    CHECK(redraw() == EXIT_SUCCESS, "diagonal scroll: redraw failed");
+    CHECK(sent(diagonal, sizeof(diagonal)) == 0, "diagonal scroll: sequence not sent");
+    for (int i = 0; i < 3; i++)
+        ssd1306_emu_scroll_step(&bus.emu);
+    CHECK(bus.emu.start_line == 3, "diagonal scroll: start line %d after 3 steps", bus.emu.start_line);
+    CHECK(shifted_mismatches(-3, 3, 0, last) == 0, "diagonal scroll: %d pixels differ after 3 steps",
+          shifted_mismatches(-3, 3, 0, last));
+
+    // stopping it puts the start line back
+    bus.cmds_len = 0;
+    oled_scroll_stop();
+    CHECK(redraw() == EXIT_SUCCESS, "diagonal scroll: redraw failed");
+    CHECK(sent(stop, 1) == 0 && sent(line0, 1) > 0, "diagonal scroll: stop or start line not sent");
+    CHECK(mismatches() == 0, "diagonal scroll: %d pixels differ after stopping", mismatches());
+}
+
+static void test_worker()
+{
+    // frames published to the bus worker, the last one sent on stop
+
+    start();
+    CHECK(oled_start_flush_thread() == EXIT_SUCCESS, "flush thread failed");
+    oled_clear_buffer();
+    for (unsigned i = 0; i < 500; i++) {
+        scribble(1000 + i, 3);
+        redraw();
+    }
+    oled_stop_flush_thread();
+    CHECK(mismatches() == 0, "worker: %d pixels differ", mismatches());
+}
+
+int main()
+{
+    test_frames();
+
+    // window command and pixel data of a full and of a partial flush
+    test_failure("full, window", 1, 1);
+    test_failure("full, data", 1, 2);
+    test_failure("partial, window", 0, 1);
+    test_failure("partial, data", 0, 2);
+
+    test_start_line();
+    test_scroll();
+    test_worker();
+
+    if (failures) {
+        fprintf(stderr, "test_oled: %d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("test_oled: ok\n");
+
+    return EXIT_SUCCESS;
+}
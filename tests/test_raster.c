@@ -0,0 +1,115 @@
+// raster kernels against their scalar reference
+//
+// random inputs at every length 0..31 and around a frame, at every
+// alignment within a 16-byte block; built for the host variant
+// (test_raster) and, through tests/neon/arm_neon.h, for the NEON one
+// (test_raster_neon)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "raster.h"
+
+#define MAX_LEN     (1024 + 33)
+#define ALIGNMENTS  16
+
+static unsigned char a[MAX_LEN + ALIGNMENTS], b[MAX_LEN + ALIGNMENTS];
+static unsigned char m[MAX_LEN + ALIGNMENTS];
+static unsigned char got[MAX_LEN + ALIGNMENTS], want[MAX_LEN + ALIGNMENTS];
+
+static void randomize(unsigned char *p, int n)
+{
+    for (int i = 0; i < n; i++)
+        p[i] = rand();
+}
+
+static void check_kernels(int off, int n)
+{
+    // fill, invert, xor and blend over [off, off + n), with the bytes
+    // around the range checked to be left alone
+
+    int size = sizeof(got);
+
+    randomize(a, size);
+    randomize(b, size);
+    randomize(m, size);
+
+    randomize(got, size);
+    memcpy(want, got, size);
+    raster_fill(got + off, a[0], n);
+    raster_fill_ref(want + off, a[0], n);
+    CHECK(!memcmp(got, want, size), "fill off=%d n=%d", off, n);
+
+    raster_invert(got + off, a + off, n);
+    raster_invert_ref(want + off, a + off, n);
+    CHECK(!memcmp(got, want, size), "invert off=%d n=%d", off, n);
+
+    raster_xor(got + off, a + off, b + off, n);
+    raster_xor_ref(want + off, a + off, b + off, n);
+    CHECK(!memcmp(got, want, size), "xor off=%d n=%d", off, n);
+
+    randomize(got, size);
+    memcpy(want, got, size);
+    raster_blend(got + off, a + off, m + off, n);
+    raster_blend_ref(want + off, a + off, m + off, n);
+    CHECK(!memcmp(got, want, size), "blend off=%d n=%d", off, n);
+}
+
+static void check_diff(int off, int n, int first, int last)
+{
+    // b equals a except at first and last (-1 = nowhere)
+
+    int f = -1, l = -1, rf = -1, rl = -1;
+    int rc, ref;
+
+    memcpy(b, a, sizeof(b));
+    if (first >= 0)
+        b[off + first] ^= 1 + rand() % 255;
+    if (last >= 0)
+        b[off + last] ^= 1 + rand() % 255;
+
+    rc = raster_diff(a + off, b + off, n, &f, &l);
+    ref = raster_diff_ref(a + off, b + off, n, &rf, &rl);
+    CHECK(rc == ref && (!rc || (f == rf && l == rl)),
+          "diff off=%d n=%d at %d..%d: %d %d..%d, ref %d %d..%d",
+          off, n, first, last, rc, f, l, ref, rf, rl);
+}
+
+static void check_length(int n)
+{
+    // differences at every position of short lengths, at the block
+    // edges and a sample of positions of long ones
+
+    for (int off = 0; off < ALIGNMENTS; off++) {
+        check_kernels(off, n);
+
+        randomize(a, sizeof(a));
+        check_diff(off, n, -1, -1);
+        for (int i = 0; i < n; i++) {
+            if (n > 64 && i % 16 != 0 && i % 16 != 15 && rand() % 8)
+                continue;
+            check_diff(off, n, i, -1);
+            check_diff(off, n, i, i + rand() % (n - i));
+        }
+    }
+}
+
+int main()
+{
+    srand(1);
+
+    for (int n = 0; n < 32; n++)
+        check_length(n);
+    for (int n = 1024 - 17; n <= MAX_LEN; n++)
+        check_length(n);
+
+    if (failures) {
+        fprintf(stderr, "test_raster (%s): %d failures\n", raster_variant(), failures);
+        return EXIT_FAILURE;
+    }
+    printf("test_raster (%s): ok\n", raster_variant());
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Convert BDF fonts into the packed glyph tables of the font engine (src/font.h).
+Run by make for every fonts/*.bdf, each file becomes `struct font font_<name>`:
+  ./tools/bdf2c.py --out src/font_data.c fonts/6x8.bdf fonts/8x16.bdf
+
+Glyphs are stored column-major in the controller layout, (height + 7) / 8
+bytes per column with the top row in the LSB, one column per advance
+pixel so an opaque blit also clears the gap to the next glyph.
+"""
+import argparse
+import re
+from pathlib import Path
+
+MAX_HEIGHT = 32         # the engine shifts columns in 64-bit words
+
+
+def parse_bdf(path: Path):
+    # returns (ascent, descent, {code: (dwidth, bbx, rows)})
+    ascent = descent = None
+    glyphs = {}
+    code = dwidth = bbx = None
+    rows = None
+
+    for line in path.read_text(encoding="latin-1").splitlines():
+        words = line.split()
+        if not words:
+            continue
+        key = words[0]
+        if rows is not None and key != "ENDCHAR":
+            rows.append(int(words[0], 16) if words[0] else 0)
+            continue
+        if key == "FONT_ASCENT":
+            ascent = int(words[1])
+        elif key == "FONT_DESCENT":
+            descent = int(words[1])
+        elif key == "STARTCHAR":
+            code, dwidth, bbx = None, None, None
+        elif key == "ENCODING":
+            code = int(words[1])
+        elif key == "DWIDTH":
+            dwidth = int(words[1])
+        elif key == "BBX":
+            bbx = tuple(int(w) for w in words[1:5])
+        elif key == "BITMAP":
+            rows = []
+        elif key == "ENDCHAR":
+            if code is not None and 0 <= code < 256 and bbx and rows is not None:
+                glyphs[code] = (dwidth if dwidth is not None else bbx[0], bbx, rows)
+            rows = None
+
+    if ascent is None or descent is None:
+        raise SystemExit(f"{path}: FONT_ASCENT/FONT_DESCENT missing")
+    return ascent, descent, glyphs
+
+
+def glyph_columns(ascent, height, dwidth, bbx, rows):
+    # render one glyph into column words, top row of the cell in bit 0
+    w, h, xoff, yoff = bbx
+    nbits = ((w + 7) // 8) * 8
+    width = max(dwidth, xoff + w, 0)
+    cols = [0] * width
+    top = ascent - (yoff + h)           # cell row of the first bitmap row
+
+    for r, bits in enumerate(rows[:h]):
+        y = top + r
+        if y < 0 or y >= height:
+            continue
+        for c in range(w):
+            x = xoff + c
+            if x >= 0 and (bits >> (nbits - 1 - c)) & 1:
+                cols[x] |= 1 << y
+    return cols
+
+
+def convert(path: Path):
+    name = re.sub(r"\W", "_", path.stem)
+    ascent, descent, glyphs = parse_bdf(path)
+    height = ascent + descent
+    if not glyphs:
+        raise SystemExit(f"{path}: no glyphs")
+    if height > MAX_HEIGHT:
+        raise SystemExit(f"{path}: {height} rows, at most {MAX_HEIGHT} supported")
+
+    first, last = min(glyphs), max(glyphs)
+    nbytes = (height + 7) // 8
+    table, data = [], []
+
+    for code in range(first, last + 1):
+        if code not in glyphs:
+            table.append((len(data) // nbytes, 0, 0, code))
+            continue
+        dwidth, bbx, rows = glyphs[code]
+        cols = glyph_columns(ascent, height, dwidth, bbx, rows)
+        table.append((len(data) // nbytes, len(cols), max(dwidth, 0), code))
+        for col in cols:
+            data += [(col >> (8 * k)) & 0xFF for k in range(nbytes)]
+
+    columns = len(data) // nbytes
+    if columns > 0xFFFF:
+        raise SystemExit(f"{path}: {columns} columns do not fit the 16-bit offsets")
+
+    out = [f"// {path.name}: {len(glyphs)} glyphs, {height} rows, {columns} columns"]
+    out.append(f"static const uint8_t font_{name}_bitmap[] = {{")
+    for i in range(0, len(data), 16):
+        out.append("    " + " ".join(f"0x{b:02X}," for b in data[i:i + 16]))
+    out.append("};")
+    out.append("")
+    out.append(f"static const struct font_glyph font_{name}_glyphs[] = {{")
+    for offset, width, advance, code in table:
+        label = chr(code) if 32 < code < 127 and chr(code) not in "\\" else f"0x{code:02X}"
+        out.append(f"    {{ {offset:5d}, {width:2d}, {advance:2d} }},     // {label}")
+    out.append("};")
+    out.append("")
+    out.append(f"struct font font_{name} = {{")
+    out.append(f"    .name = \"{name}\",")
+    out.append(f"    .height = {height},")
+    out.append(f"    .first = {first},")
+    out.append(f"    .last = {last},")
+    out.append(f"    .columns = {columns},")
+    out.append(f"    .glyphs = font_{name}_glyphs,")
+    out.append(f"    .bitmap = font_{name}_bitmap,")
+    out.append("};")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Convert BDF fonts into packed glyph tables")
+    ap.add_argument("fonts", nargs="+", help="BDF files")
+    ap.add_argument("--out", default="src/font_data.c")
+    args = ap.parse_args()
+
+    parts = ["// generated by tools/bdf2c.py from fonts/*.bdf, do not edit\n",
+             "#include \"font.h\"\n"]
+    for f in args.fonts:
+        parts.append(convert(Path(f)))
+
+    out_path = Path(args.out)
+    out_path.write_text("\n".join(parts), encoding="utf-8")
+
+if __name__ == "__main__":
+    main()